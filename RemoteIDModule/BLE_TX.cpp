@@ -14,6 +14,12 @@
 #include <BLEDevice.h>
 #include <BLEAdvertising.h>
 #include "parameters.h"
+#include "legacy_sched.h"
+#include "auth_pager.h"
+#include "pack_shaper.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 
 
@@ -49,6 +55,25 @@ static esp_ble_gap_ext_adv_params_t ext_adv_params_coded = {
     .scan_req_notif = false,
 };
 
+// the message pack on the 1M PHY, for receivers without coded PHY
+static esp_ble_gap_ext_adv_params_t ext_adv_params_1m = {
+    .type = ESP_BLE_GAP_SET_EXT_ADV_PROP_NONCONN_NONSCANNABLE_UNDIRECTED,
+    .interval_min = 1200,
+    .interval_max = 1600,
+    .channel_map = ADV_CHNL_ALL,
+    .own_addr_type = BLE_ADDR_TYPE_RANDOM,
+    .filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_WLST,
+    .tx_power = 0,
+    .primary_phy = ESP_BLE_GAP_PHY_1M,
+    .max_skip = 0,
+    .secondary_phy = ESP_BLE_GAP_PHY_1M,
+    .sid = 2,
+    .scan_req_notif = false,
+};
+
+// the auth pages in the INSTANCES legacy mode, the legacy params at the auth rate
+static esp_ble_gap_ext_adv_params_t legacy_auth_adv_params;
+
 /*
   map dBm to a TX power
  */
@@ -84,7 +109,207 @@ uint8_t BLE_TX::dBm_to_tx_power(float dBm) const
 }
 
 
-static BLEMultiAdvertising advert(2);
+/*
+  advertising instances. Instance 0 is the BT4 legacy rotation, or the
+  Location in the INSTANCES legacy mode, which uses the further legacy
+  instances for the other legacy frames and the auth pages
+ */
+#define BLE_INSTANCE_LEGACY 0
+#define BLE_INSTANCE_LONGRANGE 1
+#define BLE_INSTANCE_LEGACY_MSGS 2
+#define BLE_INSTANCE_LEGACY_END (BLE_INSTANCE_LEGACY_MSGS+6)
+#define BLE_INSTANCE_PACK_1M BLE_INSTANCE_LEGACY_END
+#define BLE_INSTANCE_LEGACY_AUTH (BLE_INSTANCE_PACK_1M+1)
+#define BLE_NUM_INSTANCES (BLE_INSTANCE_LEGACY_AUTH+1)
+
+static BLEMultiAdvertising advert(BLE_NUM_INSTANCES);
+
+BLE_TX::UpdateStats BLE_TX::update_stats[uint8_t(TxScheduler::Job::NUM_JOBS)];
+
+/*
+  asynchronous advertising data updates. BLEMultiAdvertising blocks
+  the caller until the GAP completion event, instead we issue the HCI
+  command and take the completion in our own GAP handler.
+
+  The data set completion event does not say which instance it is
+  for, so there is only one command outstanding across all the
+  instances. Updates made while a command is outstanding wait in a
+  FIFO of instances, newer data for a waiting instance replaces its
+  older data, and the next instance is issued on completion. Each
+  instance's data reaches the stack in the order it was given, so old
+  data can never be issued over newer data
+ */
+// give up on a completion event after this long
+#define ADV_DATA_TIMEOUT_US 250000
+
+static struct {
+    bool queued;
+    uint8_t length;
+    uint8_t data[251];
+} adv_updates[BLE_NUM_INSTANCES];
+
+// instances with data waiting to be issued
+static struct {
+    uint8_t instances[BLE_NUM_INSTANCES];
+    uint8_t head;
+    uint8_t count;
+} adv_fifo;
+
+// the instance with a command outstanding, -1 if none
+static int8_t adv_outstanding = -1;
+static int64_t adv_issue_us;
+
+static BLE_TX::HCIStats hci_stats[BLE_NUM_INSTANCES];
+static SemaphoreHandle_t adv_mutex;
+
+/*
+  issue the HCI command for an instance, called with adv_mutex held.
+  The stack copies the data before returning
+ */
+static bool adv_data_issue(uint8_t instance, uint8_t length, const uint8_t *data)
+{
+    auto &s = hci_stats[instance];
+    s.issued++;
+    if (esp_ble_gap_config_ext_adv_data_raw(instance, length, data) != ESP_OK) {
+        s.failed++;
+        return false;
+    }
+    adv_outstanding = instance;
+    adv_issue_us = esp_timer_get_time();
+    return true;
+}
+
+/*
+  issue the data of the next waiting instance, called with adv_mutex
+  held and no command outstanding
+ */
+static void adv_issue_next(void)
+{
+    while (adv_fifo.count > 0) {
+        const uint8_t instance = adv_fifo.instances[adv_fifo.head];
+        adv_fifo.head = (adv_fifo.head + 1) % BLE_NUM_INSTANCES;
+        adv_fifo.count--;
+        auto &u = adv_updates[instance];
+        u.queued = false;
+        if (adv_data_issue(instance, u.length, u.data)) {
+            return;
+        }
+    }
+}
+
+/*
+  GAP events from the Bluedroid task
+ */
+static void adv_gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    if (event != ESP_GAP_BLE_EXT_ADV_DATA_SET_COMPLETE_EVT) {
+        return;
+    }
+    xSemaphoreTake(adv_mutex, portMAX_DELAY);
+    // a completion after we gave up on the command is dropped
+    if (adv_outstanding >= 0) {
+        auto &s = hci_stats[adv_outstanding];
+        const uint32_t latency_us = esp_timer_get_time() - adv_issue_us;
+        s.latency_us = latency_us;
+        if (latency_us > s.latency_max_us) {
+            s.latency_max_us = latency_us;
+        }
+        if (param->ext_adv_data_set.status != ESP_BT_STATUS_SUCCESS) {
+            s.failed++;
+        }
+        adv_outstanding = -1;
+        adv_issue_next();
+    }
+    xSemaphoreGive(adv_mutex);
+}
+
+/*
+  update the advertising data of an instance without waiting for the
+  stack
+ */
+static void adv_data_update(uint8_t instance, uint8_t length, const uint8_t *data)
+{
+    xSemaphoreTake(adv_mutex, portMAX_DELAY);
+    if (adv_outstanding >= 0 && esp_timer_get_time() - adv_issue_us > ADV_DATA_TIMEOUT_US) {
+        // the completion was lost, carry on with the waiting data
+        hci_stats[adv_outstanding].failed++;
+        adv_outstanding = -1;
+        adv_issue_next();
+    }
+    auto &u = adv_updates[instance];
+    if (u.queued) {
+        hci_stats[instance].coalesced++;
+        memcpy(u.data, data, length);
+        u.length = length;
+    } else if (adv_outstanding >= 0) {
+        memcpy(u.data, data, length);
+        u.length = length;
+        u.queued = true;
+        adv_fifo.instances[(adv_fifo.head + adv_fifo.count) % BLE_NUM_INSTANCES] = instance;
+        adv_fifo.count++;
+    } else {
+        adv_data_issue(instance, length, data);
+    }
+    xSemaphoreGive(adv_mutex);
+}
+
+void BLE_TX::get_hci_stats(uint8_t instance, HCIStats &s)
+{
+    if (instance >= BLE_NUM_INSTANCES || adv_mutex == nullptr) {
+        memset(&s, 0, sizeof(s));
+        return;
+    }
+    xSemaphoreTake(adv_mutex, portMAX_DELAY);
+    s = hci_stats[instance];
+    xSemaphoreGive(adv_mutex);
+}
+
+uint8_t BLE_TX::num_instances(void)
+{
+    return BLE_NUM_INSTANCES;
+}
+
+/*
+  instance for a legacy frame in the INSTANCES mode
+ */
+static uint8_t legacy_frame_instance(uint8_t frame_idx)
+{
+    const uint8_t location = uint8_t(ODIDCache::Msg::LOCATION);
+    if (frame_idx == location) {
+        return BLE_INSTANCE_LEGACY;
+    }
+    return BLE_INSTANCE_LEGACY_MSGS + (frame_idx < location ? frame_idx : frame_idx-1);
+}
+
+/*
+  advertising params for an instance
+ */
+static const esp_ble_gap_ext_adv_params_t *instance_params(uint8_t instance)
+{
+    switch (instance) {
+    case BLE_INSTANCE_LONGRANGE:
+        return &ext_adv_params_coded;
+    case BLE_INSTANCE_PACK_1M:
+        return &ext_adv_params_1m;
+    case BLE_INSTANCE_LEGACY_AUTH:
+        return &legacy_auth_adv_params;
+    default:
+        break;
+    }
+    return &legacy_adv_params;
+}
+
+/*
+  set power and min/max interval based on output rate
+ */
+static void set_adv_params(esp_ble_gap_ext_adv_params_t &params, float rate, uint8_t tx_power)
+{
+    params.tx_power = tx_power;
+    if (rate > 0) {
+        params.interval_max = (1000/rate)/0.625;
+        params.interval_min = 0.75*params.interval_max;
+    }
+}
 
 bool BLE_TX::init(void)
 {
@@ -94,15 +319,24 @@ bool BLE_TX::init(void)
     initialised = true;
     BLEDevice::init("");
 
-    // setup power levels
-    legacy_adv_params.tx_power = dBm_to_tx_power(g.bt4_power);
-    ext_adv_params_coded.tx_power = dBm_to_tx_power(g.bt5_power);
-
-    // set min/max interval based on output rate    
-    legacy_adv_params.interval_max =  (1000/(g.bt4_rate*7))/0.625;
-    legacy_adv_params.interval_min = 0.75*legacy_adv_params.interval_max;
-    ext_adv_params_coded.interval_max =  (1000/(g.bt5_rate))/0.625;
-    ext_adv_params_coded.interval_min = 0.75*ext_adv_params_coded.interval_max;
+    adv_mutex = xSemaphoreCreateMutex();
+    BLEDevice::setCustomGapHandler(adv_gap_event);
+
+    // setup power levels and intervals for the parameters, the radio
+    // task then applies the broadcast profile
+    profile.bt4_rate = g.bt4_rate;
+    profile.bt4_power = g.bt4_power;
+    profile.bt5_rate = g.bt5_rate;
+    profile.bt5_power = g.bt5_power;
+    profile.bt5_1m_rate = g.bt5_1m_rate;
+    profile.bt5_1m_power = g.bt5_1m_power;
+    legacy_mode = LegacyMode(g.bt4_mode);
+    // in the INSTANCES mode each message is on its own instance at the
+    // BT4 rate, otherwise the rotation of up to 7 frames is on one
+    const float bt4_mult = legacy_mode == LegacyMode::INSTANCES ? 1 : 7;
+    set_adv_params(legacy_adv_params, profile.bt4_rate*bt4_mult, dBm_to_tx_power(profile.bt4_power));
+    set_adv_params(ext_adv_params_coded, profile.bt5_rate, dBm_to_tx_power(profile.bt5_power));
+    set_adv_params(ext_adv_params_1m, profile.bt5_1m_rate, dBm_to_tx_power(profile.bt5_1m_power));
 
     // generate random mac address
     uint8_t mac_addr[6];
@@ -111,13 +345,30 @@ bool BLE_TX::init(void)
     // set as a bluetooth random static address
     mac_addr[0] |= 0xc0;
 
-    advert.setAdvertisingParams(0, &legacy_adv_params);
-    advert.setInstanceAddress(0, mac_addr);
-    advert.setDuration(0);
+    advert.setAdvertisingParams(BLE_INSTANCE_LEGACY, &legacy_adv_params);
+    advert.setInstanceAddress(BLE_INSTANCE_LEGACY, mac_addr);
+    advert.setDuration(BLE_INSTANCE_LEGACY);
 
-    advert.setAdvertisingParams(1, &ext_adv_params_coded);
-    advert.setDuration(1);
-    advert.setInstanceAddress(1, mac_addr);
+    advert.setAdvertisingParams(BLE_INSTANCE_LONGRANGE, &ext_adv_params_coded);
+    advert.setDuration(BLE_INSTANCE_LONGRANGE);
+    advert.setInstanceAddress(BLE_INSTANCE_LONGRANGE, mac_addr);
+
+    advert.setAdvertisingParams(BLE_INSTANCE_PACK_1M, &ext_adv_params_1m);
+    advert.setDuration(BLE_INSTANCE_PACK_1M);
+    advert.setInstanceAddress(BLE_INSTANCE_PACK_1M, mac_addr);
+
+    if (legacy_mode == LegacyMode::INSTANCES) {
+        // same address on all instances, so receivers see one aircraft
+        for (uint8_t i=BLE_INSTANCE_LEGACY_MSGS; i<BLE_INSTANCE_LEGACY_END; i++) {
+            advert.setAdvertisingParams(i, &legacy_adv_params);
+            advert.setInstanceAddress(i, mac_addr);
+            advert.setDuration(i);
+        }
+        set_auth_params();
+        advert.setAdvertisingParams(BLE_INSTANCE_LEGACY_AUTH, &legacy_auth_adv_params);
+        advert.setInstanceAddress(BLE_INSTANCE_LEGACY_AUTH, mac_addr);
+        advert.setDuration(BLE_INSTANCE_LEGACY_AUTH);
+    }
 
     // prefer S8 coding
     if (esp_ble_gap_set_prefered_default_phy(ESP_BLE_GAP_PHY_OPTIONS_PREF_S8_CODING, ESP_BLE_GAP_PHY_OPTIONS_PREF_S8_CODING) != ESP_OK) {
@@ -125,194 +376,412 @@ bool BLE_TX::init(void)
     }
 
     memset(&msg_counters,0, sizeof(msg_counters));
+    for (auto &pack : packs) {
+        pack.counter = 0;
+    }
     return true;
 }
 
+/*
+  the params of an instance can't be changed while it is advertising,
+  so a running instance is stopped, updated and restarted
+ */
+void BLE_TX::apply_params(uint8_t instance)
+{
+    const bool running = (started_mask & (1U<<instance)) != 0;
+    if (running) {
+        advert.stop(1, &instance);
+    }
+    advert.setAdvertisingParams(instance, instance_params(instance));
+    if (running) {
+        advert.start(1, instance);
+    }
+}
+
+/*
+  start an instance advertising once it has its first data
+ */
+void BLE_TX::start_instance(uint8_t instance)
+{
+    if ((started_mask & (1U<<instance)) == 0) {
+        advert.start(1, instance);
+        started_mask |= (1U<<instance);
+    }
+}
+
+uint8_t BLE_TX::legacy_cycle_length(const ODID_UAS_Data &UAS_data) const
+{
+    if (legacy_mode == LegacyMode::INSTANCES) {
+        return 1;
+    }
+    return UAS_data.BasicIDValid[1] ? 7 : 6;
+}
+
+void BLE_TX::set_profile(float bt4_rate, float bt4_power, float bt5_rate, float bt5_power, float bt5_1m_rate, float bt5_1m_power)
+{
+    if (!initialised) {
+        return;
+    }
+    if (bt4_rate != profile.bt4_rate || bt4_power != profile.bt4_power) {
+        profile.bt4_rate = bt4_rate;
+        profile.bt4_power = bt4_power;
+        const float bt4_mult = legacy_mode == LegacyMode::INSTANCES ? 1 : 7;
+        set_adv_params(legacy_adv_params, bt4_rate*bt4_mult, dBm_to_tx_power(bt4_power));
+        apply_params(BLE_INSTANCE_LEGACY);
+        if (legacy_mode == LegacyMode::INSTANCES) {
+            for (uint8_t i=BLE_INSTANCE_LEGACY_MSGS; i<BLE_INSTANCE_LEGACY_END; i++) {
+                apply_params(i);
+            }
+            set_auth_params();
+            apply_params(BLE_INSTANCE_LEGACY_AUTH);
+        }
+    }
+    if (bt5_rate != profile.bt5_rate || bt5_power != profile.bt5_power) {
+        profile.bt5_rate = bt5_rate;
+        profile.bt5_power = bt5_power;
+        set_adv_params(ext_adv_params_coded, bt5_rate, dBm_to_tx_power(bt5_power));
+        apply_params(BLE_INSTANCE_LONGRANGE);
+    }
+    if (bt5_1m_rate != profile.bt5_1m_rate || bt5_1m_power != profile.bt5_1m_power) {
+        profile.bt5_1m_rate = bt5_1m_rate;
+        profile.bt5_1m_power = bt5_1m_power;
+        set_adv_params(ext_adv_params_1m, bt5_1m_rate, dBm_to_tx_power(bt5_1m_power));
+        apply_params(BLE_INSTANCE_PACK_1M);
+    }
+}
+
 #define IMIN(a,b) ((a)<(b)?(a):(b))
 
-bool BLE_TX::transmit_longrange(ODID_UAS_Data &UAS_data)
+bool BLE_TX::transmit_longrange(ODID_UAS_Data &UAS_data, const ODIDCache &cache)
+{
+    init();
+    return transmit_pack(BLE_INSTANCE_LONGRANGE, TxScheduler::Job::BT5, packs[0], cache);
+}
+
+bool BLE_TX::transmit_pack_1m(ODID_UAS_Data &UAS_data, const ODIDCache &cache)
 {
     init();
-    // create a packed UAS data message
-    uint8_t payload[250];
-    int length = odid_message_build_pack(&UAS_data, payload, 255);
+    return transmit_pack(BLE_INSTANCE_PACK_1M, TxScheduler::Job::BT5_1M, packs[1], cache);
+}
+
+/*
+  set the message pack as the extended advertising data of an instance
+ */
+bool BLE_TX::transmit_pack(uint8_t instance, TxScheduler::Job job, PackData &pack, const ODIDCache &cache)
+{
+    // setup ASTM header, the message counter is filled in below
+    uint8_t payload[250] { 0, 0x16, 0xfa, 0xff, 0x0d, 0 };
+    const uint8_t counter_ofs = 5;
+
+    // create a packed UAS data message from the encoded message cache
+    const uint8_t msg_mask = pack_shaper.select(job, cache);
+    const uint8_t msg_count = cache.num_available(msg_mask);
+    const uint16_t auth_mask = auth_pager.select(job, cache, msg_count, ODID_PACK_MAX_MESSAGES - msg_count);
+    int length = cache.build_pack(&payload[counter_ofs+1], sizeof(payload)-(counter_ofs+1), msg_mask, auth_mask);
     if (length <= 0) {
         return false;
     }
+    payload[0] = uint8_t(length+5);
+    length += counter_ofs+1;
 
-    // setup ASTM header
-    const uint8_t header[] { uint8_t(length+5), 0x16, 0xfa, 0xff, 0x0d, uint8_t(msg_counters[ODID_MSG_COUNTER_PACKED]++) };
+    if (g.ble_skip_same && same_data(pack.payload, pack.length, payload, length, counter_ofs)) {
+        // the pack is already loaded
+        update_stats[uint8_t(job)].skipped++;
+        return true;
+    }
 
-    // combine header with payload
-    memcpy(longrange_payload, header, sizeof(header));
-    memcpy(&longrange_payload[sizeof(header)], payload, length);
-    int longrange_length = sizeof(header) + length;
+    payload[counter_ofs] = pack.counter++;
+    memcpy(pack.payload, payload, length);
+    pack.length = length;
 
-    advert.setAdvertisingData(1, longrange_length, longrange_payload);
+    adv_data_update(instance, pack.length, pack.payload);
+    update_stats[uint8_t(job)].issued++;
 
     // we start advertising when we have the first lot of data to send
-    if (!started) {
-        advert.start();
-    }
-    started = true;
+    start_instance(instance);
 
     return true;
 }
 
-bool BLE_TX::transmit_legacy(ODID_UAS_Data &UAS_data)
+/*
+  true if data matches the loaded advertising data, apart from the
+  message counter at counter_ofs. counter_ofs of 0 compares all of it
+ */
+bool BLE_TX::same_data(const uint8_t *loaded, uint8_t loaded_length, const uint8_t *data, uint8_t length, uint8_t counter_ofs)
 {
-    init();
-    static uint8_t legacy_phase = 0;
-    int legacy_length = 0;
-    // setup ASTM header
-    const uint8_t header[] { 0x1e, 0x16, 0xfa, 0xff, 0x0d }; //exclude the message counter
-    // combine header with payload
-    memset(legacy_payload, 0, sizeof(legacy_payload));
-    memcpy(legacy_payload, header, sizeof(header));
-    legacy_length = sizeof(header);
-
-    switch (legacy_phase)
-    {
-    case  0: {
-        if (UAS_data.LocationValid) {
-            ODID_Location_encoded location_encoded;
-            memset(&location_encoded, 0, sizeof(location_encoded));
-            if (encodeLocationMessage(&location_encoded, &UAS_data.Location) != ODID_SUCCESS) {
-                break;
-            }
+    if (length != loaded_length) {
+        return false;
+    }
+    if (counter_ofs == 0) {
+        return memcmp(loaded, data, length) == 0;
+    }
+    return memcmp(loaded, data, counter_ofs) == 0 &&
+           memcmp(&loaded[counter_ofs+1], &data[counter_ofs+1], length-(counter_ofs+1)) == 0;
+}
 
-            memcpy(&legacy_payload[sizeof(header)], &msg_counters[ODID_MSG_COUNTER_LOCATION], 1); //set packet counter
-            msg_counters[ODID_MSG_COUNTER_LOCATION]++;
-            //msg_counters[ODID_MSG_COUNTER_LOCATION] %= 256; //likely not be needed as it is defined as unint_8
+// ASTM legacy advertising header, the message counter follows it
+static const uint8_t legacy_header[] { 0x1e, 0x16, 0xfa, 0xff, 0x0d };
 
-            memcpy(&legacy_payload[sizeof(header) + 1], &location_encoded, sizeof(location_encoded));
-            legacy_length = sizeof(header) + 1 + sizeof(location_encoded);
+/*
+  the prebuilt frame for a cached message. If the message is not
+  available the frame is just the header
+ */
+BLE_TX::LegacyFrame &BLE_TX::legacy_frame(const ODIDCache &cache, ODIDCache::Msg msg)
+{
+    auto &f = legacy_frames[uint8_t(msg)];
+    const uint32_t generation = cache.get_generation(msg);
+    /*
+      the radio task re-encodes the Location into its own copy of the
+      cache for extrapolation, so its generation is not unique to the
+      contents. It changes on nearly every transmit anyway, so always
+      rebuild it
+     */
+    if (f.valid && f.generation == generation && msg != ODIDCache::Msg::LOCATION) {
+        return f;
+    }
+    uint8_t length = sizeof(legacy_header);
+    const bool available = cache.available(msg);
+    if (available) {
+        length += 1 + ODID_MESSAGE_SIZE;
+    }
+    if (!f.valid || f.length != length ||
+        (available && memcmp(&f.payload[sizeof(legacy_header) + 1], cache.get(msg), ODID_MESSAGE_SIZE) != 0)) {
+        memcpy(f.payload, legacy_header, sizeof(legacy_header));
+        if (available) {
+            memcpy(&f.payload[sizeof(legacy_header) + 1], cache.get(msg), ODID_MESSAGE_SIZE);
         }
-        break;
+        f.length = length;
+        f.changed = true;
     }
+    f.generation = generation;
+    f.valid = true;
+    return f;
+}
 
-    case  1: {
-        if (UAS_data.BasicIDValid[0]) {
-            ODID_BasicID_encoded basicid_encoded;
-            memset(&basicid_encoded, 0, sizeof(basicid_encoded));
-            if (encodeBasicIDMessage(&basicid_encoded, &UAS_data.BasicID[0]) != ODID_SUCCESS) {
-                break;
-            }
+/*
+  the frame with the BLE name, from the tail of BasicID 1
+ */
+BLE_TX::LegacyFrame &BLE_TX::legacy_name_frame(const ODID_UAS_Data &UAS_data, const ODIDCache &cache)
+{
+    auto &f = legacy_frames[LEGACY_NAME_FRAME];
+    const uint32_t generation = cache.get_generation(ODIDCache::Msg::BASIC_ID_1);
+    if (f.valid && f.generation == generation) {
+        return f;
+    }
+    char legacy_name[28] {};
+    const char *UAS_ID = (const char *)UAS_data.BasicID[0].UASID;
+    const uint8_t ID_len = strlen(UAS_ID);
+    const uint8_t ID_tail = IMIN(4, ID_len);
+    snprintf(legacy_name, sizeof(legacy_name), "ArduRemoteID_%s", &UAS_ID[ID_len-ID_tail]);
+
+    memset(f.payload, 0, sizeof(f.payload));
+    const uint8_t legacy_name_header[] { 0x02, 0x01, 0x06, uint8_t(strlen(legacy_name)+1), ESP_BLE_AD_TYPE_NAME_SHORT};
+
+    memcpy(f.payload, legacy_name_header, sizeof(legacy_name_header));
+    memcpy(&f.payload[sizeof(legacy_name_header)], legacy_name, strlen(legacy_name) + 1);
+
+    f.length = sizeof(legacy_name_header) + strlen(legacy_name) + 1; //add extra char for \0
+    f.generation = generation;
+    f.valid = true;
+    f.changed = true;
+    return f;
+}
 
-            memcpy(&legacy_payload[sizeof(header)], &msg_counters[ODID_MSG_COUNTER_BASIC_ID], 1); //set packet counter
-            msg_counters[ODID_MSG_COUNTER_BASIC_ID]++;
-            //msg_counters[ODID_MSG_COUNTER_BASIC_ID] %= 256; //likely not be needed as it is defined as unint_8
+void BLE_TX::set_legacy_priority(ODIDCache::Msg msg)
+{
+    legacy_priority = msg;
+    legacy_priority_pending = true;
+}
 
-            memcpy(&legacy_payload[sizeof(header) + 1], &basicid_encoded, sizeof(basicid_encoded));
-            legacy_length = sizeof(header) + 1 + sizeof(basicid_encoded);
-        }
+/*
+  message counter index for a cached message
+ */
+static uint8_t legacy_counter_idx(ODIDCache::Msg msg)
+{
+    switch (msg) {
+    case ODIDCache::Msg::LOCATION:
+        return ODID_MSG_COUNTER_LOCATION;
+    case ODIDCache::Msg::SELF_ID:
+        return ODID_MSG_COUNTER_SELF_ID;
+    case ODIDCache::Msg::SYSTEM:
+        return ODID_MSG_COUNTER_SYSTEM;
+    case ODIDCache::Msg::OPERATOR_ID:
+        return ODID_MSG_COUNTER_OPERATOR_ID;
+    default:
         break;
     }
+    return ODID_MSG_COUNTER_BASIC_ID;
+}
 
-    case  2: {
-        if (UAS_data.SelfIDValid) {
-            ODID_SelfID_encoded selfid_encoded;
-            memset(&selfid_encoded, 0, sizeof(selfid_encoded));
-            if (encodeSelfIDMessage(&selfid_encoded, &UAS_data.SelfID) != ODID_SUCCESS) {
-                break;
-            }
+bool BLE_TX::transmit_legacy(ODID_UAS_Data &UAS_data, const ODIDCache &cache)
+{
+    init();
 
-            memcpy(&legacy_payload[sizeof(header)], &msg_counters[ODID_MSG_COUNTER_SELF_ID], 1); //set packet counter
-            msg_counters[ODID_MSG_COUNTER_SELF_ID]++;
-            //msg_counters[ODID_MSG_COUNTER_SELF_ID] %= 256; //likely not be needed as it is defined as uint_8
+    if (legacy_mode == LegacyMode::INSTANCES) {
+        // changed messages, including any priority message, all go
+        // out now
+        legacy_priority_pending = false;
+        return legacy_send_instances(UAS_data, cache);
+    }
 
-            memcpy(&legacy_payload[sizeof(header) + 1], &selfid_encoded, sizeof(selfid_encoded));
-            legacy_length = sizeof(header) + 1 + sizeof(selfid_encoded);
+    if (legacy_priority_pending) {
+        legacy_priority_pending = false;
+        if (cache.available(legacy_priority)) {
+            return legacy_send(legacy_priority, legacy_frame(cache, legacy_priority));
         }
-        break;
     }
 
-    case  3: {
-        if (UAS_data.SystemValid) {
-            ODID_System_encoded system_encoded;
-            memset(&system_encoded, 0, sizeof(system_encoded));
-            if (encodeSystemMessage(&system_encoded, &UAS_data.System) != ODID_SUCCESS) {
-                break;
-            }
-
-            memcpy(&legacy_payload[sizeof(header)], &msg_counters[ODID_MSG_COUNTER_SYSTEM], 1); //set packet counter
-            msg_counters[ODID_MSG_COUNTER_SYSTEM]++;
-            //msg_counters[ODID_MSG_COUNTER_SYSTEM] %= 256; //likely not be needed as it is defined as uint_8
+    // an auth page in place of a frame, within the auth budget
+    const uint16_t auth_mask = auth_pager.select(TxScheduler::Job::BT4, cache, 0, 1);
+    if (auth_mask != 0) {
+        return legacy_send_auth(cache, __builtin_ctz(auth_mask), BLE_INSTANCE_LEGACY);
+    }
 
-            memcpy(&legacy_payload[sizeof(header) + 1], &system_encoded, sizeof(system_encoded));
-            legacy_length = sizeof(header) + 1 + sizeof(system_encoded);
+    // the BLE name is always available
+    uint8_t available_mask = 1U<<LEGACY_NAME_FRAME;
+    for (uint8_t i=0; i<uint8_t(ODIDCache::Msg::NUM_MSGS); i++) {
+        if (cache.available(ODIDCache::Msg(i))) {
+            available_mask |= 1U<<i;
         }
-        break;
     }
+    const uint8_t frame = legacy_sched.next(available_mask, millis());
+    if (frame == LEGACY_NAME_FRAME) {
+        return legacy_send(ODIDCache::Msg::NUM_MSGS, legacy_name_frame(UAS_data, cache));
+    }
+    const ODIDCache::Msg msg = ODIDCache::Msg(frame);
+    return legacy_send(msg, legacy_frame(cache, msg));
+}
 
-    case  4: {
-        if (UAS_data.OperatorIDValid) {
-            ODID_OperatorID_encoded operatorid_encoded;
-            memset(&operatorid_encoded, 0, sizeof(operatorid_encoded));
-            if (encodeOperatorIDMessage(&operatorid_encoded, &UAS_data.OperatorID) != ODID_SUCCESS) {
-                break;
-            }
-
-            memcpy(&legacy_payload[sizeof(header)], &msg_counters[ODID_MSG_COUNTER_OPERATOR_ID], 1); //set packet counter
-            msg_counters[ODID_MSG_COUNTER_OPERATOR_ID]++;
-            //msg_counters[ODID_MSG_COUNTER_OPERATOR_ID] %= 256; //likely not be needed as it is defined as uint_8
+/*
+  patch the message counter into a frame and set it as the legacy
+  advertising data. msg is NUM_MSGS for the name frame, which has no
+  counter
+ */
+bool BLE_TX::legacy_send(ODIDCache::Msg msg, LegacyFrame &frame)
+{
+    const bool has_counter = msg != ODIDCache::Msg::NUM_MSGS && frame.length > sizeof(legacy_header);
+    legacy_location = has_counter && msg == ODIDCache::Msg::LOCATION;
+
+    /*
+      frames without a counter are skipped when already loaded. With
+      BLE_SKIP_SAME so are frames that only differ in the counter, the
+      counter then holds until the message changes
+     */
+    if ((!has_counter || g.ble_skip_same) &&
+        same_data(legacy_loaded, legacy_loaded_length, frame.payload, frame.length, has_counter ? sizeof(legacy_header) : 0)) {
+        update_stats[uint8_t(TxScheduler::Job::BT4)].skipped++;
+        return true;
+    }
 
-            memcpy(&legacy_payload[sizeof(header) + 1], &operatorid_encoded, sizeof(operatorid_encoded));
-            legacy_length = sizeof(header) + 1 + sizeof(operatorid_encoded);
-        }
-        break;
+    if (has_counter) {
+        frame.payload[sizeof(legacy_header)] = msg_counters[legacy_counter_idx(msg)]++;
     }
 
-    case  5: //in case of dual basic ID
-        if (UAS_data.BasicIDValid[1]) {
-            ODID_BasicID_encoded basicid2_encoded;
-            memset(&basicid2_encoded, 0, sizeof(basicid2_encoded));
-            if (encodeBasicIDMessage(&basicid2_encoded, &UAS_data.BasicID[1]) != ODID_SUCCESS) {
-                break;
-            }
+    adv_data_update(BLE_INSTANCE_LEGACY, frame.length, frame.payload);
+    update_stats[uint8_t(TxScheduler::Job::BT4)].issued++;
+    memcpy(legacy_loaded, frame.payload, frame.length);
+    legacy_loaded_length = frame.length;
 
-            memcpy(&legacy_payload[sizeof(header)], &msg_counters[ODID_MSG_COUNTER_BASIC_ID], 1); //set packet counter
-            msg_counters[ODID_MSG_COUNTER_BASIC_ID]++;
-            //msg_counters[ODID_MSG_COUNTER_BASIC_ID] %= 256; //likely not be needed as it is defined as unint_8
+    start_instance(BLE_INSTANCE_LEGACY);
 
-            memcpy(&legacy_payload[sizeof(header) + 1], &basicid2_encoded, sizeof(basicid2_encoded));
-            legacy_length = sizeof(header) + 1 + sizeof(basicid2_encoded);
-        }
-        break;
+    return true;
+}
 
-    case  6: {
-        //set BLE name
-        char legacy_name[28] {};
-        const char *UAS_ID = (const char *)UAS_data.BasicID[0].UASID;
-        const uint8_t ID_len = strlen(UAS_ID);
-        const uint8_t ID_tail = IMIN(4, ID_len);
-        snprintf(legacy_name, sizeof(legacy_name), "ArduRemoteID_%s", &UAS_ID[ID_len-ID_tail]);
+/*
+  send an auth page as the legacy advertising data of an instance,
+  the rotation instance or the auth instance of the INSTANCES mode
+ */
+bool BLE_TX::legacy_send_auth(const ODIDCache &cache, uint8_t page, uint8_t instance)
+{
+    uint8_t payload[sizeof(legacy_header) + 1 + ODID_MESSAGE_SIZE];
+    memcpy(payload, legacy_header, sizeof(legacy_header));
+    payload[sizeof(legacy_header)] = msg_counters[ODID_MSG_COUNTER_AUTH]++;
+    memcpy(&payload[sizeof(legacy_header) + 1], cache.get_auth(page), ODID_MESSAGE_SIZE);
+
+    adv_data_update(instance, sizeof(payload), payload);
+    update_stats[uint8_t(TxScheduler::Job::BT4)].issued++;
+    if (instance == BLE_INSTANCE_LEGACY) {
+        legacy_location = false;
+        memcpy(legacy_loaded, payload, sizeof(payload));
+        legacy_loaded_length = sizeof(payload);
+    }
 
-        memset(legacy_payload, 0, sizeof(legacy_payload));
-        const uint8_t legacy_name_header[] { 0x02, 0x01, 0x06, uint8_t(strlen(legacy_name)+1), ESP_BLE_AD_TYPE_NAME_SHORT};
+    start_instance(instance);
 
-        memcpy(legacy_payload, legacy_name_header, sizeof(legacy_name_header));
-        memcpy(&legacy_payload[sizeof(legacy_name_header)], legacy_name, strlen(legacy_name) + 1);
+    return true;
+}
 
-        legacy_length = sizeof(legacy_name_header) + strlen(legacy_name) + 1; //add extra char for \0
-        break;
+/*
+  set the interval of the auth instance of the INSTANCES mode. Each
+  legacy frame has its own instance at the BT4 rate, so the auth
+  instance runs at the AUTH_BUDGET share of the legacy frames on air
+ */
+void BLE_TX::set_auth_params(void)
+{
+    legacy_auth_budget = g.auth_budget;
+    const float budget = g.auth_budget * 0.01;
+    const float auth_rate = profile.bt4_rate * (LEGACY_NAME_FRAME+1) * budget / (1 - budget);
+    legacy_auth_adv_params = legacy_adv_params;
+    set_adv_params(legacy_auth_adv_params, auth_rate, legacy_adv_params.tx_power);
+}
+
+/*
+  load the next auth page on the auth instance of the INSTANCES mode,
+  or stop the instance when there is no auth data. The pages take turns
+  at the rate of the instance, so each is on air about once per cycle
+ */
+void BLE_TX::legacy_update_auth_instance(const ODIDCache &cache)
+{
+    const uint8_t instance = BLE_INSTANCE_LEGACY_AUTH;
+    if (cache.auth_pages() == 0 || g.auth_budget <= 0) {
+        if ((started_mask & (1U<<instance)) != 0) {
+            advert.stop(1, &instance);
+            started_mask &= ~(1U<<instance);
+        }
+        return;
     }
+    if (g.auth_budget != legacy_auth_budget) {
+        set_auth_params();
+        apply_params(instance);
     }
-
-    legacy_phase++;
-
-    if (UAS_data.BasicIDValid[1]) {
-        legacy_phase %= 7;
-    } else {
-        legacy_phase %= 6;
+    const uint16_t auth_mask = auth_pager.select(TxScheduler::Job::BT4, cache, LEGACY_NAME_FRAME+1, 1);
+    if (auth_mask != 0) {
+        legacy_send_auth(cache, __builtin_ctz(auth_mask), instance);
     }
+}
 
-    advert.setAdvertisingData(0, legacy_length, legacy_payload);
-
-    if (!started) {
-        advert.start();
+/*
+  update the instances of the legacy frames that have changed, the
+  controller repeats each one at the BT4 rate
+ */
+bool BLE_TX::legacy_send_instances(ODID_UAS_Data &UAS_data, const ODIDCache &cache)
+{
+    legacy_location = false;
+    for (uint8_t i=0; i<=LEGACY_NAME_FRAME; i++) {
+        const ODIDCache::Msg msg = ODIDCache::Msg(i);
+        LegacyFrame &f = i == LEGACY_NAME_FRAME ? legacy_name_frame(UAS_data, cache) : legacy_frame(cache, msg);
+        if (!f.changed) {
+            continue;
+        }
+        f.changed = false;
+        const uint8_t instance = legacy_frame_instance(i);
+        const bool running = (started_mask & (1U<<instance)) != 0;
+        if (i != LEGACY_NAME_FRAME && f.length <= sizeof(legacy_header)) {
+            // message no longer available
+            if (running) {
+                advert.stop(1, &instance);
+                started_mask &= ~(1U<<instance);
+            }
+            continue;
+        }
+        if (i != LEGACY_NAME_FRAME) {
+            f.payload[sizeof(legacy_header)] = msg_counters[legacy_counter_idx(msg)]++;
+            legacy_location |= (msg == ODIDCache::Msg::LOCATION);
+        }
+        adv_data_update(instance, f.length, f.payload);
+        update_stats[uint8_t(TxScheduler::Job::BT4)].issued++;
+        start_instance(instance);
     }
-    started = true;
-
+    legacy_update_auth_instance(cache);
     return true;
 }
@@ -4,19 +4,129 @@
 #pragma once
 
 #include "transmitter.h"
+#include "odid_cache.h"
+#include "scheduler.h"
 
 class BLE_TX : public Transmitter {
 public:
     bool init(void) override;
-    bool transmit_longrange(ODID_UAS_Data &UAS_data);
-    bool transmit_legacy(ODID_UAS_Data &UAS_data);
+    bool transmit_longrange(ODID_UAS_Data &UAS_data, const ODIDCache &cache);
+    // the message pack as BT5 extended advertising on the 1M PHY
+    bool transmit_pack_1m(ODID_UAS_Data &UAS_data, const ODIDCache &cache);
+    bool transmit_legacy(ODID_UAS_Data &UAS_data, const ODIDCache &cache);
+
+    /*
+      send msg in the next legacy transmit, out of the normal cycle.
+      The cycle then carries on where it left off
+     */
+    void set_legacy_priority(ODIDCache::Msg msg);
+
+    /*
+      set the advertising rates and powers for a broadcast profile,
+      applied immediately if they have changed
+     */
+    void set_profile(float bt4_rate, float bt4_power, float bt5_rate, float bt5_power, float bt5_1m_rate, float bt5_1m_power);
+
+    // true if the last legacy transmit carried the Location message
+    bool legacy_sent_location(void) const {
+        return legacy_location;
+    }
+
+    /*
+      BT4 legacy advertising modes. In ROTATE the CPU cycles one
+      instance through the messages. In INSTANCES each message has its
+      own instance which the controller repeats, and the CPU only
+      updates an instance when its message changes
+     */
+    enum class LegacyMode : uint8_t {
+        ROTATE=0,
+        INSTANCES=1,
+    };
+
+    // number of legacy transmits to send every message once
+    uint8_t legacy_cycle_length(const ODID_UAS_Data &UAS_data) const;
+
+    // advertising data updates issued to the stack and skipped, per BLE job
+    struct UpdateStats {
+        uint32_t issued;
+        uint32_t skipped;
+    };
+
+    static const UpdateStats &get_update_stats(TxScheduler::Job job) {
+        return update_stats[uint8_t(job)];
+    }
+
+    // HCI advertising data commands for one instance
+    struct HCIStats {
+        uint32_t issued;
+        uint32_t failed;
+        // data replaced while waiting for a command to complete
+        uint32_t coalesced;
+        uint32_t latency_us;
+        uint32_t latency_max_us;
+    };
+
+    static void get_hci_stats(uint8_t instance, HCIStats &s);
+    static uint8_t num_instances(void);
 
 private:
     bool initialised;
     uint8_t msg_counters[ODID_MSG_COUNTER_AMOUNT];
-    uint8_t legacy_payload[36];
-    uint8_t longrange_payload[250];
-    bool started;
+    // the data loaded on the message pack and legacy rotation instances
+    struct PackData {
+        uint8_t payload[250];
+        uint8_t length;
+        // each pack instance is its own stream, so has its own counter
+        uint8_t counter;
+    } packs[2];
+    uint8_t legacy_loaded[31];
+    uint8_t legacy_loaded_length;
+    // advertising instances that have been started
+    uint16_t started_mask;
+    LegacyMode legacy_mode;
+    bool legacy_priority_pending;
+    ODIDCache::Msg legacy_priority;
+    bool legacy_location;
+
+    struct {
+        float bt4_rate;
+        float bt4_power;
+        float bt5_rate;
+        float bt5_power;
+        float bt5_1m_rate;
+        float bt5_1m_power;
+    } profile;
+    // AUTH_BUDGET the auth instance interval was set from
+    float legacy_auth_budget;
+
+    /*
+      prebuilt legacy advertising frames, one per cached message plus
+      the name frame. A frame is rebuilt when the generation of its
+      source message changes, then each transmit only patches in the
+      message counter
+     */
+    static const uint8_t LEGACY_NAME_FRAME = uint8_t(ODIDCache::Msg::NUM_MSGS);
+    struct LegacyFrame {
+        uint8_t payload[31];
+        uint8_t length;
+        uint32_t generation;
+        bool valid;
+        // rebuilt since it was last set on its own instance
+        bool changed;
+    } legacy_frames[LEGACY_NAME_FRAME+1];
 
     uint8_t dBm_to_tx_power(float dBm) const;
+    static UpdateStats update_stats[uint8_t(TxScheduler::Job::NUM_JOBS)];
+
+    static bool same_data(const uint8_t *loaded, uint8_t loaded_length, const uint8_t *data, uint8_t length, uint8_t counter_ofs);
+    LegacyFrame &legacy_frame(const ODIDCache &cache, ODIDCache::Msg msg);
+    LegacyFrame &legacy_name_frame(const ODID_UAS_Data &UAS_data, const ODIDCache &cache);
+    bool transmit_pack(uint8_t instance, TxScheduler::Job job, PackData &pack, const ODIDCache &cache);
+    bool legacy_send(ODIDCache::Msg msg, LegacyFrame &frame);
+    bool legacy_send_auth(const ODIDCache &cache, uint8_t page, uint8_t instance);
+    void legacy_update_auth_instance(const ODIDCache &cache);
+    void set_auth_params(void);
+    bool legacy_send_instances(ODID_UAS_Data &UAS_data, const ODIDCache &cache);
+    void start_instance(uint8_t instance);
+    void apply_params(uint8_t instance);
 };
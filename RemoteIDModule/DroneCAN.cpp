@@ -11,6 +11,7 @@
 #include <stdarg.h>
 #include "util.h"
 #include "monocypher.h"
+#include "timesync.h"
 
 #include <canard.h>
 #include <uavcan.protocol.NodeStatus.h>
@@ -19,6 +20,7 @@
 #include <uavcan.protocol.dynamic_node_id.Allocation.h>
 #include <uavcan.protocol.param.GetSet.h>
 #include <uavcan.protocol.debug.LogMessage.h>
+#include <uavcan.protocol.GlobalTimeSync.h>
 #include <dronecan.remoteid.BasicID.h>
 #include <dronecan.remoteid.Location.h>
 #include <dronecan.remoteid.SelfID.h>
@@ -116,12 +118,10 @@ void DroneCAN::arm_status_send(void)
     uint8_t buffer[DRONECAN_REMOTEID_ARMSTATUS_MAX_SIZE];
     dronecan_remoteid_ArmStatus arm_status {};
 
-    const uint8_t status = parse_fail==nullptr? MAV_ODID_ARM_STATUS_GOOD_TO_ARM:MAV_ODID_ARM_STATUS_PRE_ARM_FAIL_GENERIC;
-    const char *reason = parse_fail==nullptr?"":parse_fail;
+    const uint8_t status = parse_fail==ARM_FAIL_NONE? MAV_ODID_ARM_STATUS_GOOD_TO_ARM:MAV_ODID_ARM_STATUS_PRE_ARM_FAIL_GENERIC;
 
     arm_status.status = status;
-    arm_status.error.len = strlen(reason);
-    strncpy((char*)arm_status.error.data, reason, sizeof(arm_status.error.data));
+    arm_status.error.len = format_arm_fail(parse_fail, (char*)arm_status.error.data, sizeof(arm_status.error.data));
 
     const uint16_t len = dronecan_remoteid_ArmStatus_encode(&arm_status, buffer);
 
@@ -180,6 +180,9 @@ void DroneCAN::onTransferReceived(CanardInstance* ins,
     case UAVCAN_PROTOCOL_PARAM_GETSET_ID:
         handle_param_getset(ins, transfer);
         break;
+    case UAVCAN_PROTOCOL_GLOBALTIMESYNC_ID:
+        handle_GlobalTimeSync(transfer);
+        break;
     case DRONECAN_REMOTEID_SECURECOMMAND_ID:
         handle_SecureCommand(ins, transfer);
         break;
@@ -212,6 +215,7 @@ bool DroneCAN::shouldAcceptTransfer(const CanardInstance* ins,
         ACCEPT_ID(DRONECAN_REMOTEID_SYSTEM);
         ACCEPT_ID(DRONECAN_REMOTEID_SECURECOMMAND);
         ACCEPT_ID(UAVCAN_PROTOCOL_PARAM_GETSET);
+        ACCEPT_ID(UAVCAN_PROTOCOL_GLOBALTIMESYNC);
         return true;
     }
     //Serial.printf("%u: reject ID 0x%x\n", millis(), data_type_id);
@@ -502,6 +506,7 @@ void DroneCAN::handle_BasicID(CanardRxTransfer* transfer)
         COPY_FIELD(ua_type);
         COPY_STR(uas_id);
         last_basic_id_ms = millis();
+        generation.basic_id++;
     }
 }
 
@@ -515,6 +520,8 @@ void DroneCAN::handle_SelfID(CanardRxTransfer* transfer)
     COPY_STR(id_or_mac);
     COPY_FIELD(description_type);
     COPY_STR(description);
+    generation.self_id++;
+    update_emergency();
 }
 
 void DroneCAN::handle_System(CanardRxTransfer* transfer)
@@ -543,6 +550,7 @@ void DroneCAN::handle_System(CanardRxTransfer* transfer)
     COPY_FIELD(class_eu);
     COPY_FIELD(operator_altitude_geo);
     COPY_FIELD(timestamp);
+    generation.system++;
 }
 
 void DroneCAN::handle_OperatorID(CanardRxTransfer* transfer)
@@ -556,6 +564,7 @@ void DroneCAN::handle_OperatorID(CanardRxTransfer* transfer)
     COPY_STR(id_or_mac);
     COPY_FIELD(operator_id_type);
     COPY_STR(operator_id);
+    generation.operator_id++;
 }
 
 void DroneCAN::handle_Location(CanardRxTransfer* transfer)
@@ -587,6 +596,28 @@ void DroneCAN::handle_Location(CanardRxTransfer* transfer)
     COPY_FIELD(speed_accuracy);
     COPY_FIELD(timestamp);
     COPY_FIELD(timestamp_accuracy);
+    generation.location++;
+    update_emergency();
+}
+
+/*
+  each GlobalTimeSync carries the master's time when it sent the
+  previous one, so pair it with the time we received the previous one
+ */
+void DroneCAN::handle_GlobalTimeSync(CanardRxTransfer* transfer)
+{
+    uavcan_protocol_GlobalTimeSync pkt {};
+    uavcan_protocol_GlobalTimeSync_decode(transfer, &pkt);
+    auto &ts = global_time_sync;
+    if (pkt.previous_transmission_timestamp_usec != 0 &&
+        ts.rx_us != 0 &&
+        transfer->source_node_id == ts.node_id &&
+        transfer->transfer_id == ((ts.transfer_id + 1) & 31)) {
+        timesync.set_utc(pkt.previous_transmission_timestamp_usec, ts.rx_us, TimeSync::Source::DRONECAN);
+    }
+    ts.rx_us = transfer->timestamp_usec;
+    ts.node_id = transfer->source_node_id;
+    ts.transfer_id = transfer->transfer_id;
 }
 
 /*
@@ -52,11 +52,19 @@ private:
 
     uavcan_protocol_NodeStatus node_status;
 
+    // the last GlobalTimeSync received
+    struct {
+        uint64_t rx_us;
+        uint8_t node_id;
+        uint8_t transfer_id;
+    } global_time_sync;
+
     void handle_BasicID(CanardRxTransfer* transfer);
     void handle_SelfID(CanardRxTransfer* transfer);
     void handle_OperatorID(CanardRxTransfer* transfer);
     void handle_System(CanardRxTransfer* transfer);
     void handle_Location(CanardRxTransfer* transfer);
+    void handle_GlobalTimeSync(CanardRxTransfer* transfer);
     void handle_param_getset(CanardInstance* ins, CanardRxTransfer* transfer);
     void handle_SecureCommand(CanardInstance* ins, CanardRxTransfer* transfer);
 
@@ -24,6 +24,17 @@
 #include <esp_ota_ops.h>
 #include "efuse.h"
 #include "led.h"
+#include "scheduler.h"
+#include "odid_cache.h"
+#include "snapshot.h"
+#include "profile.h"
+#include "power.h"
+#include "boot.h"
+#include "emergency.h"
+#include "tx_profile.h"
+#include "extrapolate.h"
+#include "timesync.h"
+#include "latency.h"
 
 
 #if AP_DRONECAN_ENABLED
@@ -40,9 +51,26 @@ static BLE_TX ble;
 
 #define DEBUG_BAUDRATE 57600
 
+// radio task setup. loop() runs on ARDUINO_RUNNING_CORE (core 1)
+#define RADIO_TASK_STACK 8192
+#define RADIO_TASK_PRIORITY 2
+#define RADIO_TASK_CORE 0
+#define RADIO_MAX_SLEEP_US 10000
+
+// location age after which the flight state is unknown and we use the
+// airborne broadcast profile
+#define PROFILE_LINK_TIMEOUT_MS 3000
+
+// background task for the slow startup checks
+#define BOOT_TASK_STACK 8192
+#define BOOT_TASK_PRIORITY 1
+
+static void radio_task(void *arg);
+static void boot_task(void *arg);
+
 // OpenDroneID output data structure
 ODID_UAS_Data UAS_data;
-String status_reason;
+uint32_t status_reason;  // Transport::ArmFail bitmask
 static uint32_t last_location_ms;
 static WebInterface webif;
 
@@ -52,6 +80,17 @@ static WebInterface webif;
 static bool arm_check_ok = false; // goes true for LED arm check status
 static bool pfst_check_ok = false;
 
+// WiFi is used for broadcast and for the web server
+static bool wifi_wanted(void)
+{
+    return g.webserver_enable || g.wifi_nan_rate > 0 || g.wifi_beacon_rate > 0;
+}
+
+static bool ble_wanted(void)
+{
+    return g.bt4_rate > 0 || g.bt5_rate > 0 || g.bt5_1m_rate > 0;
+}
+
 /*
   setup serial ports
  */
@@ -61,20 +100,31 @@ void setup()
     WRITE_PERI_REG(RTC_CNTL_BROWN_OUT_REG, 0);
 
     g.init();
+    boot.mark(BootTimeline::Phase::PARAMS);
 
     led.set_state(Led::LedState::INIT);
     led.update();
 
-    if (g.webserver_enable) {
-        // need WiFi for web server
-        wifi.init();
-    }
-
     // Serial for debug printf
     Serial.begin(g.baudrate);
 
     // Serial1 for MAVLink
     Serial1.begin(g.baudrate, SERIAL_8N1, PIN_UART_RX, PIN_UART_TX);
+    boot.mark(BootTimeline::Phase::SERIAL_PORTS);
+
+    power.init(PowerManager::Mode(g.power_mode), wifi_wanted() || ble_wanted());
+
+    /*
+      radio output runs in its own task, on the other core to loop()
+      where we have two cores. It is started early as it brings up the
+      radios, so BLE and WiFi init runs in parallel with the rest of
+      setup
+     */
+#if CONFIG_FREERTOS_UNICORE
+    xTaskCreate(radio_task, "radio", RADIO_TASK_STACK, nullptr, RADIO_TASK_PRIORITY, nullptr);
+#else
+    xTaskCreatePinnedToCore(radio_task, "radio", RADIO_TASK_STACK, nullptr, RADIO_TASK_PRIORITY, nullptr, RADIO_TASK_CORE);
+#endif
 
     // set all fields to invalid/initial values
     odid_initUasData(&UAS_data);
@@ -86,11 +136,10 @@ void setup()
 #if AP_DRONECAN_ENABLED
     dronecan.init();
 #endif
+    boot.mark(BootTimeline::Phase::TRANSPORTS);
 
     set_efuses();
 
-    CheckFirmware::check_OTA_running();
-
 #if defined(PIN_CAN_EN)
     // optional CAN enable pin
     pinMode(PIN_CAN_EN, OUTPUT);
@@ -132,81 +181,85 @@ void setup()
     esp_log_level_set("*", ESP_LOG_DEBUG);
 
     esp_ota_mark_app_valid_cancel_rollback();
+
+    // firmware check runs in the background once we are broadcasting
+    xTaskCreate(boot_task, "boot", BOOT_TASK_STACK, nullptr, BOOT_TASK_PRIORITY, nullptr);
+
+    boot.mark(BootTimeline::Phase::SETUP);
 }
 
 #define IMIN(x,y) ((x)<(y)?(x):(y))
 #define ODID_COPY_STR(to, from) strncpy(to, (const char*)from, IMIN(sizeof(to), sizeof(from)))
 
+/*
+  generation counts of the transport and parameter data last copied
+  into UAS_data, so set_data() only rebuilds what has changed
+ */
+static struct {
+    bool initialised;
+    Transport::Generation transport;
+    uint32_t params;
+} uas_gen;
+
+/*
+  loop() may override Location.Status and LocationValid for the web
+  interface, so the Location built from the transport is kept here and
+  restored on each pass
+ */
+static ODID_Location_data location_shadow;
+static uint8_t location_shadow_valid;
+
+/*
+  per message encoding errors, updated when a message is rebuilt and
+  encoded into the cache
+ */
+static struct {
+    bool location;
+    bool system;
+    bool basic_id[ODID_BASIC_ID_MAX_MESSAGES];
+    bool self_id;
+    bool operator_id;
+} parse_error;
+
 /*
   check parsing of UAS_data, this checks ranges of values to ensure we
   will produce a valid pack
-  returns nullptr on no error, or a string error
+  returns a Transport::ArmFail bitmask of the bad messages
  */
-static const char *check_parse(void)
+static uint32_t check_parse(void)
 {
-    String ret = "";
+    uint32_t ret = Transport::ARM_FAIL_NONE;
 
-    {
-        ODID_Location_encoded encoded {};
-        if (encodeLocationMessage(&encoded, &UAS_data.Location) != ODID_SUCCESS) {
-            ret += "LOC ";
-        }
+    if (parse_error.location) {
+        ret |= Transport::ARM_FAIL_BAD_LOC;
     }
-    {
-        ODID_System_encoded encoded {};
-        if (encodeSystemMessage(&encoded, &UAS_data.System) != ODID_SUCCESS) {
-            ret += "SYS ";
-        }
+    if (parse_error.system) {
+        ret |= Transport::ARM_FAIL_BAD_SYS;
     }
-    {
-        ODID_BasicID_encoded encoded {};
-        if (UAS_data.BasicIDValid[0] == 1) {
-            if (encodeBasicIDMessage(&encoded, &UAS_data.BasicID[0]) != ODID_SUCCESS) {
-                ret += "ID_1 ";
-            }
-        }
-        memset(&encoded, 0, sizeof(encoded));
-        if (UAS_data.BasicIDValid[1] == 1) {
-            if (encodeBasicIDMessage(&encoded, &UAS_data.BasicID[1]) != ODID_SUCCESS) {
-                ret += "ID_2 ";
-            }
-        }
+    if (parse_error.basic_id[0]) {
+        ret |= Transport::ARM_FAIL_BAD_ID_1;
     }
-    {
-        ODID_SelfID_encoded encoded {};
-        if (encodeSelfIDMessage(&encoded, &UAS_data.SelfID) != ODID_SUCCESS) {
-            ret += "SELF_ID ";
-        }
+    if (parse_error.basic_id[1]) {
+        ret |= Transport::ARM_FAIL_BAD_ID_2;
     }
-    {
-        ODID_OperatorID_encoded encoded {};
-        if (encodeOperatorIDMessage(&encoded, &UAS_data.OperatorID) != ODID_SUCCESS) {
-            ret += "OP_ID ";
-        }
+    if (parse_error.self_id) {
+        ret |= Transport::ARM_FAIL_BAD_SELF_ID;
     }
-    if (ret.length() > 0) {
-        // if all errors would occur in this function, it will fit in
-        // 50 chars that is also the max for the arm status message
-        static char return_string[50];
-        memset(return_string, 0, sizeof(return_string));
-        snprintf(return_string, sizeof(return_string)-1, "bad %s data", ret.c_str());
-        return return_string;
+    if (parse_error.operator_id) {
+        ret |= Transport::ARM_FAIL_BAD_OP_ID;
     }
-    return nullptr;
+    return ret;
 }
 
 /*
-  fill in UAS_data from MAVLink packets
+  rebuild BasicID from the transport and parameters
  */
-static void set_data(Transport &t)
+static void set_basic_id(const mavlink_open_drone_id_basic_id_t &basic_id)
 {
-    const auto &operator_id = t.get_operator_id();
-    const auto &basic_id = t.get_basic_id();
-    const auto &system = t.get_system();
-    const auto &self_id = t.get_self_id();
-    const auto &location = t.get_location();
-
-    odid_initUasData(&UAS_data);
+    for (uint8_t i=0; i<ODID_BASIC_ID_MAX_MESSAGES; i++) {
+        odid_initBasicIDData(&UAS_data.BasicID[i]);
+        UAS_data.BasicIDValid[i] = 0;
+    }
 
     /*
       if we don't have BasicID info from parameters and we have it
@@ -281,21 +334,42 @@ static void set_data(Transport &t)
         }
     }
 
-    // OperatorID
+    for (uint8_t i=0; i<ODID_BASIC_ID_MAX_MESSAGES; i++) {
+        const bool valid = UAS_data.BasicIDValid[i] == 1;
+        parse_error.basic_id[i] = !odid_cache.set_basic_id(i, UAS_data.BasicID[i], valid) && valid;
+    }
+}
+
+static void set_operator_id(const mavlink_open_drone_id_operator_id_t &operator_id)
+{
+    odid_initOperatorIDData(&UAS_data.OperatorID);
+    UAS_data.OperatorIDValid = 0;
     if (strlen(operator_id.operator_id) > 0) {
         UAS_data.OperatorID.OperatorIdType = (ODID_operatorIdType_t)operator_id.operator_id_type;
         ODID_COPY_STR(UAS_data.OperatorID.OperatorId, operator_id.operator_id);
         UAS_data.OperatorIDValid = 1;
     }
 
-    // SelfID
+    parse_error.operator_id = !odid_cache.set_operator_id(UAS_data.OperatorID, UAS_data.OperatorIDValid);
+}
+
+static void set_self_id(const mavlink_open_drone_id_self_id_t &self_id)
+{
+    odid_initSelfIDData(&UAS_data.SelfID);
+    UAS_data.SelfIDValid = 0;
     if (strlen(self_id.description) > 0) {
         UAS_data.SelfID.DescType = (ODID_desctype_t)self_id.description_type;
         ODID_COPY_STR(UAS_data.SelfID.Desc, self_id.description);
         UAS_data.SelfIDValid = 1;
     }
 
-    // System
+    parse_error.self_id = !odid_cache.set_self_id(UAS_data.SelfID, UAS_data.SelfIDValid);
+}
+
+static void set_system(const mavlink_open_drone_id_system_t &system)
+{
+    odid_initSystemData(&UAS_data.System);
+    UAS_data.SystemValid = 0;
     if (system.timestamp != 0) {
         UAS_data.System.OperatorLocationType = (ODID_operator_location_type_t)system.operator_location_type;
         UAS_data.System.ClassificationType = (ODID_classification_type_t)system.classification_type;
@@ -312,32 +386,133 @@ static void set_data(Transport &t)
         UAS_data.SystemValid = 1;
     }
 
-    // Location
+    parse_error.system = !odid_cache.set_system(UAS_data.System, UAS_data.SystemValid);
+}
+
+static void set_location(const mavlink_open_drone_id_location_t &location)
+{
+    auto &loc = location_shadow;
+    odid_initLocationData(&loc);
+    location_shadow_valid = 0;
     if (location.timestamp != 0) {
-        UAS_data.Location.Status = (ODID_status_t)location.status;
-        UAS_data.Location.Direction = location.direction*0.01;
-        UAS_data.Location.SpeedHorizontal = location.speed_horizontal*0.01;
-        UAS_data.Location.SpeedVertical = location.speed_vertical*0.01;
-        UAS_data.Location.Latitude = location.latitude*1.0e-7;
-        UAS_data.Location.Longitude = location.longitude*1.0e-7;
-        UAS_data.Location.AltitudeBaro = location.altitude_barometric;
-        UAS_data.Location.AltitudeGeo = location.altitude_geodetic;
-        UAS_data.Location.HeightType = (ODID_Height_reference_t)location.height_reference;
-        UAS_data.Location.Height = location.height;
-        UAS_data.Location.HorizAccuracy = (ODID_Horizontal_accuracy_t)location.horizontal_accuracy;
-        UAS_data.Location.VertAccuracy = (ODID_Vertical_accuracy_t)location.vertical_accuracy;
-        UAS_data.Location.BaroAccuracy = (ODID_Vertical_accuracy_t)location.barometer_accuracy;
-        UAS_data.Location.SpeedAccuracy = (ODID_Speed_accuracy_t)location.speed_accuracy;
-        UAS_data.Location.TSAccuracy = (ODID_Timestamp_accuracy_t)location.timestamp_accuracy;
-        UAS_data.Location.TimeStamp = location.timestamp;
-        UAS_data.LocationValid = 1;
-    }
-
-    const char *reason = check_parse();
-    t.arm_status_check(reason);
-    t.set_parse_fail(reason);
-
-    arm_check_ok = (reason==nullptr);
+        loc.Status = (ODID_status_t)location.status;
+        loc.Direction = location.direction*0.01;
+        loc.SpeedHorizontal = location.speed_horizontal*0.01;
+        loc.SpeedVertical = location.speed_vertical*0.01;
+        loc.Latitude = location.latitude*1.0e-7;
+        loc.Longitude = location.longitude*1.0e-7;
+        loc.AltitudeBaro = location.altitude_barometric;
+        loc.AltitudeGeo = location.altitude_geodetic;
+        loc.HeightType = (ODID_Height_reference_t)location.height_reference;
+        loc.Height = location.height;
+        loc.HorizAccuracy = (ODID_Horizontal_accuracy_t)location.horizontal_accuracy;
+        loc.VertAccuracy = (ODID_Vertical_accuracy_t)location.vertical_accuracy;
+        loc.BaroAccuracy = (ODID_Vertical_accuracy_t)location.barometer_accuracy;
+        loc.SpeedAccuracy = (ODID_Speed_accuracy_t)location.speed_accuracy;
+        loc.TSAccuracy = (ODID_Timestamp_accuracy_t)location.timestamp_accuracy;
+        loc.TimeStamp = location.timestamp;
+        location_shadow_valid = 1;
+    }
+
+    parse_error.location = !odid_cache.set_location(loc, location_shadow_valid);
+}
+
+/*
+  rebuild the auth pages, only pages whose MAVLink message has changed
+  are encoded again. A page is valid when it belongs to the sequence
+  described by page 0
+ */
+static void set_auth(Transport &t)
+{
+    static mavlink_open_drone_id_authentication_t auth_shadow[ODID_AUTH_MAX_PAGES];
+    // only page 0 carries a timestamp
+    const auto &page0 = t.get_authentication(0);
+    const uint8_t last_page = page0.timestamp != 0 ? page0.last_page_index : 0;
+
+    for (uint8_t i=0; i<ODID_AUTH_MAX_PAGES; i++) {
+        const auto &auth = t.get_authentication(i);
+        const uint8_t valid = page0.timestamp != 0 && auth.data_page == i && i <= last_page;
+        if (valid == UAS_data.AuthValid[i] &&
+            memcmp(&auth, &auth_shadow[i], sizeof(auth)) == 0) {
+            continue;
+        }
+        auth_shadow[i] = auth;
+
+        auto &a = UAS_data.Auth[i];
+        odid_initAuthData(&a);
+        UAS_data.AuthValid[i] = valid;
+        if (valid) {
+            a.AuthType = (ODID_authtype_t)auth.authentication_type;
+            a.DataPage = auth.data_page;
+            a.LastPageIndex = auth.last_page_index;
+            a.Length = auth.length;
+            a.Timestamp = auth.timestamp;
+            memcpy(a.AuthData, auth.authentication_data,
+                   i == 0 ? ODID_AUTH_PAGE_ZERO_DATA_SIZE : ODID_AUTH_PAGE_NONZERO_DATA_SIZE);
+        }
+        odid_cache.set_auth(i, a, valid);
+    }
+}
+
+/*
+  fill in UAS_data from MAVLink packets, only rebuilding the messages
+  which have changed since the last call
+ */
+static void set_data(Transport &t)
+{
+    const auto &gen = t.get_generation();
+    const uint32_t param_gen = g.get_generation();
+    const bool all = !uas_gen.initialised;
+    bool changed = all;
+
+    if (all || gen.basic_id != uas_gen.transport.basic_id || param_gen != uas_gen.params) {
+        uas_gen.transport.basic_id = gen.basic_id;
+        set_basic_id(t.get_basic_id());
+        // persisting the BasicID changes parameters, pick up the
+        // generation after that so we don't rebuild again
+        uas_gen.params = g.get_generation();
+        changed = true;
+    }
+    if (all || gen.operator_id != uas_gen.transport.operator_id) {
+        uas_gen.transport.operator_id = gen.operator_id;
+        set_operator_id(t.get_operator_id());
+        changed = true;
+    }
+    if (all || gen.self_id != uas_gen.transport.self_id) {
+        uas_gen.transport.self_id = gen.self_id;
+        set_self_id(t.get_self_id());
+        changed = true;
+    }
+    if (all || gen.system != uas_gen.transport.system) {
+        uas_gen.transport.system = gen.system;
+        set_system(t.get_system());
+        changed = true;
+    }
+    if (all || gen.location != uas_gen.transport.location) {
+        uas_gen.transport.location = gen.location;
+        set_location(t.get_location());
+        changed = true;
+    }
+    if (all || gen.authentication != uas_gen.transport.authentication) {
+        uas_gen.transport.authentication = gen.authentication;
+        set_auth(t);
+        changed = true;
+    }
+    uas_gen.initialised = true;
+
+    UAS_data.Location = location_shadow;
+    UAS_data.LocationValid = location_shadow_valid;
+
+    static uint32_t parse_reasons;
+    if (changed) {
+        PROFILE_SCOPE(CHECK_PARSE);
+        parse_reasons = check_parse();
+    }
+    uint32_t reasons = parse_reasons;
+    t.arm_status_check(reasons);
+    t.set_parse_fail(reasons);
+
+    arm_check_ok = (reasons==Transport::ARM_FAIL_NONE);
 
     if (g.options & OPTIONS_FORCE_ARM_OK) {
         arm_check_ok = true;
@@ -353,16 +528,221 @@ static void set_data(Transport &t)
     }
 }
 
-static uint8_t loop_counter = 0;
+/*
+  the longest we can sleep between transport updates without
+  overflowing the UART or CAN receive queues
+ */
+static uint32_t max_sleep_us(void)
+{
+    // time to fill half of the 256 byte UART receive buffer
+    const uint32_t fill_us = uint32_t((128 * 10 * 1000000ULL) / g.baudrate);
+    return constrain(fill_us, 1000U, 10000U);
+}
 
-void loop()
+/*
+  bring up the radios we will use, so the first transmit is not held
+  up by init. WiFi is also needed for the web server
+ */
+static void radio_init(void)
+{
+    if (wifi_wanted()) {
+        wifi.init();
+    }
+    if (ble_wanted()) {
+        ble.init();
+    }
+    boot.mark(BootTimeline::Phase::RADIO_INIT);
+}
+
+/*
+  project the location in the radio task's copy of the message cache
+  forward to now. Always starts from the location as received, so
+  the projection doesn't accumulate
+ */
+static void extrapolate_location(UASSnapshot &snap)
+{
+    if (g.dr_horizon <= 0 || !snap.uas.LocationValid || snap.location_ms == 0) {
+        return;
+    }
+    ODID_Location_data loc = snap.uas.Location;
+    if (extrapolator.project(loc, millis() - snap.location_ms, g.dr_horizon)) {
+        snap.cache.set_location(loc, true);
+    }
+}
+
+/*
+  radio task, owns the BLE and WiFi transmitters. It only sees the UAS
+  data through the snapshot published by loop(), so broadcast timing
+  does not depend on transport or web server load
+ */
+static void radio_task(void *arg)
+{
+    // snapshot of the UAS data for the transmitters, large so keep it
+    // off the task stack
+    static UASSnapshot snap;
+
+    radio_init();
+
+    while (true) {
+        power.acquire(PowerManager::Lock::RADIO);
+
+        uas_snapshot.fetch(snap);
+
+        const bool new_emergency = emergency.is_new(snap.emergency.count);
+        if (new_emergency) {
+            emergency.start(snap.emergency.count, snap.emergency.start_us, g.emergency_burst);
+        }
+
+        // rates and powers for the flight state, applied to the radios
+        // only when they change
+        TxProfile::Settings ps;
+        TxProfile::get_settings(snap.profile, ps);
+        wifi.set_profile(ps.wifi_beacon_rate, ps.wifi_power);
+        ble.set_profile(ps.bt4_rate, ps.bt4_power, ps.bt5_rate, ps.bt5_power, ps.bt5_1m_rate, ps.bt5_1m_power);
+
+        const int bt4_states = ble.legacy_cycle_length(snap.uas);
+        const bool tx = snap.transmit;
+        const float scale = emergency.rate_scale();
+        tx_sched.set_rate(TxScheduler::Job::WIFI_NAN, tx ? ps.wifi_nan_rate * scale : 0);
+        tx_sched.set_rate(TxScheduler::Job::WIFI_BEACON, tx ? ps.wifi_beacon_rate * scale : 0);
+        tx_sched.set_rate(TxScheduler::Job::BT5, tx ? ps.bt5_rate * scale : 0);
+        tx_sched.set_rate(TxScheduler::Job::BT4, tx ? ps.bt4_rate * bt4_states * scale : 0);
+        tx_sched.set_rate(TxScheduler::Job::BT5_1M, tx ? ps.bt5_1m_rate * scale : 0);
+
+        if (new_emergency) {
+            // send on every enabled radio now, with BT4 sending the
+            // message that carries the emergency first
+            ble.set_legacy_priority(snap.emergency.from_self_id ? ODIDCache::Msg::SELF_ID : ODIDCache::Msg::LOCATION);
+            for (uint8_t i=0; i<uint8_t(TxScheduler::Job::NUM_JOBS); i++) {
+                tx_sched.trigger(TxScheduler::Job(i));
+            }
+        }
+
+        TxScheduler::Job job;
+        bool extrapolated = false;
+        while (tx_sched.pop_due(job)) {
+            if (!extrapolated) {
+                extrapolate_location(snap);
+                extrapolated = true;
+            }
+            bool sent = false;
+            switch (job) {
+            case TxScheduler::Job::WIFI_NAN: {
+                PROFILE_SCOPE(TX_WIFI_NAN);
+                sent = wifi.transmit_nan(snap.uas, snap.cache);
+                break;
+            }
+            case TxScheduler::Job::WIFI_BEACON: {
+                PROFILE_SCOPE(TX_WIFI_BEACON);
+                sent = wifi.transmit_beacon(snap.uas, snap.cache);
+                break;
+            }
+            case TxScheduler::Job::BT5: {
+                PROFILE_SCOPE(TX_BT5);
+                sent = ble.transmit_longrange(snap.uas, snap.cache);
+                break;
+            }
+            case TxScheduler::Job::BT4: {
+                PROFILE_SCOPE(TX_BT4);
+                sent = ble.transmit_legacy(snap.uas, snap.cache);
+                break;
+            }
+            case TxScheduler::Job::BT5_1M: {
+                PROFILE_SCOPE(TX_BT5_1M);
+                sent = ble.transmit_pack_1m(snap.uas, snap.cache);
+                break;
+            }
+            default:
+                break;
+            }
+            if (sent) {
+                boot.mark(BootTimeline::Phase::FIRST_TX);
+                emergency.sent(job);
+                // BT4 only carries the Location in some of its frames
+                if (snap.uas.LocationValid &&
+                    (job != TxScheduler::Job::BT4 || ble.legacy_sent_location())) {
+                    tx_latency.sent(job, snap.uas.Location.TimeStamp);
+                }
+            } else {
+                tx_sched.tx_failed(job);
+            }
+        }
+
+        power.release(PowerManager::Lock::RADIO);
+
+        // wake at least every RADIO_MAX_SLEEP_US to pick up rate changes
+        tx_sched.sleep_until_next(RADIO_MAX_SLEEP_US);
+    }
+}
+
+/*
+  slow startup work, held back until broadcasting has begun so it
+  does not delay the first Remote ID frame
+ */
+static void boot_task(void *arg)
+{
+    while (!boot.broadcast_started()) {
+        delay(10);
+    }
+
+    CheckFirmware::check_OTA_running();
+    boot.mark(BootTimeline::Phase::FW_CHECK);
+
+    boot.print();
+    vTaskDelete(nullptr);
+}
+
+/*
+  publish UAS_data to the radio task if it has changed. A new
+  emergency wakes the radio task so it goes out immediately
+ */
+static void publish_snapshot(bool transmit, const Transport::Emergency &em, bool link_ok,
+                             uint32_t location_ms)
 {
+    static bool published;
+    static bool last_transmit;
+    static uint32_t last_generation;
+    static uint32_t last_emergency_count;
+    static TxProfile::State last_profile;
+    static uint32_t published_location_ms;
+    const uint32_t generation = odid_cache.get_generation();
+    const TxProfile::State profile = tx_profile.update(UAS_data.Location.Status, link_ok);
+    if (published && transmit == last_transmit && generation == last_generation &&
+        em.count == last_emergency_count && profile == last_profile &&
+        location_ms == published_location_ms) {
+        return;
+    }
+    uas_snapshot.publish(UAS_data, odid_cache, transmit, em, profile, location_ms);
+    published = true;
+    last_transmit = transmit;
+    last_generation = generation;
+    last_profile = profile;
+    published_location_ms = location_ms;
+    if (em.count != last_emergency_count) {
+        last_emergency_count = em.count;
+        tx_sched.wake();
+    }
+}
+
+/*
+  one pass of the ingest task
+ */
+static void update_ingest(void)
+{
+    PROFILE_SCOPE(LOOP);
+
 #if AP_MAVLINK_ENABLED
-    mavlink1.update();
-    mavlink2.update();
+    {
+        PROFILE_SCOPE(MAVLINK_UPDATE);
+        mavlink1.update();
+        mavlink2.update();
+    }
 #endif
 #if AP_DRONECAN_ENABLED
-    dronecan.update();
+    {
+        PROFILE_SCOPE(DRONECAN_UPDATE);
+        dronecan.update();
+    }
 #endif
 
     const uint32_t now_ms = millis();
@@ -377,13 +757,17 @@ void loop()
     #error "Must enable DroneCAN or MAVLink"
 #endif
 
-    bool have_location = false;
     const uint32_t last_location_ms = transport.get_last_location_ms();
     const uint32_t last_system_ms = transport.get_last_system_ms();
+    const bool link_ok = last_location_ms != 0 &&
+        now_ms - last_location_ms < PROFILE_LINK_TIMEOUT_MS;
 
-    led.update();
+    {
+        PROFILE_SCOPE(LED_UPDATE);
+        led.update();
+    }
 
-    status_reason = "";
+    status_reason = Transport::ARM_FAIL_NONE;
 
     if (last_location_ms == 0 ||
         now_ms - last_location_ms > 5000) {
@@ -395,14 +779,17 @@ void loop()
         UAS_data.Location.Status = ODID_STATUS_REMOTE_ID_SYSTEM_FAILURE;
     }
 
-    if (transport.get_parse_fail() != nullptr) {
+    if (transport.get_parse_fail() != Transport::ARM_FAIL_NONE) {
         UAS_data.Location.Status = ODID_STATUS_REMOTE_ID_SYSTEM_FAILURE;
-        status_reason = String(transport.get_parse_fail());
+        status_reason = transport.get_parse_fail();
     }
 
-    // web update has to happen after we update Status above
-    if (g.webserver_enable) {
+    // web update has to happen after we update Status above. The web
+    // server is started once broadcasting has begun
+    if (g.webserver_enable && boot.broadcast_started()) {
+        PROFILE_SCOPE(WEBIF_UPDATE);
         webif.update();
+        boot.mark(BootTimeline::Phase::WEBSERVER);
     }
 
     if (g.bcast_powerup) {
@@ -415,42 +802,30 @@ void loop()
     } else {
         // only broadcast if we have received a location at least once
         if (last_location_ms == 0) {
-            delay(1);
+            publish_snapshot(false, transport.get_emergency(), link_ok, last_location_ms);
             return;
         }
     }
 
-    set_data(transport);
-
-    static uint32_t last_update_wifi_nan_ms;
-    if (g.wifi_nan_rate > 0 &&
-        now_ms - last_update_wifi_nan_ms > 1000/g.wifi_nan_rate) {
-        last_update_wifi_nan_ms = now_ms;
-        wifi.transmit_nan(UAS_data);
-    }
-
-    static uint32_t last_update_wifi_beacon_ms;
-    if (g.wifi_beacon_rate > 0 &&
-        now_ms - last_update_wifi_beacon_ms > 1000/g.wifi_beacon_rate) {
-        last_update_wifi_beacon_ms = now_ms;
-        wifi.transmit_beacon(UAS_data);
+    {
+        PROFILE_SCOPE(SET_DATA);
+        set_data(transport);
     }
 
-    static uint32_t last_update_bt5_ms;
-    if (g.bt5_rate > 0 &&
-        now_ms - last_update_bt5_ms > 1000/g.bt5_rate) {
-        last_update_bt5_ms = now_ms;
-        ble.transmit_longrange(UAS_data);
-    }
+    publish_snapshot(true, transport.get_emergency(), link_ok, last_location_ms);
+}
 
-    static uint32_t last_update_bt4_ms;
-    int bt4_states = UAS_data.BasicIDValid[1] ? 7 : 6;
-    if (g.bt4_rate > 0 &&
-        now_ms - last_update_bt4_ms > (1000.0f/bt4_states)/g.bt4_rate) {
-        last_update_bt4_ms = now_ms;
-        ble.transmit_legacy(UAS_data);
+/*
+  the Arduino loop is the ingest task, it owns the transports,
+  parameters and the web interface
+ */
+void loop()
+{
+    {
+        PowerLockScope lock(PowerManager::Lock::INGEST);
+        update_ingest();
     }
 
-    // sleep for a bit for power saving
-    delay(1);
+    // sleep, waking in time to service the transports
+    delay(max_sleep_us() / 1000);
 }
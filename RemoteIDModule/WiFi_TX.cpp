@@ -8,7 +8,27 @@
 #include <esp_wifi.h>
 #include <WiFi.h>
 #include <esp_system.h>
+#include <esp_timer.h>
 #include "parameters.h"
+#include "util.h"
+#include "auth_pager.h"
+#include "pack_shaper.h"
+
+WiFi_TX::BuildStats WiFi_TX::build_stats;
+WiFi_TX::NanStats WiFi_TX::nan_stats;
+WiFi_TX::IEStats WiFi_TX::ie_stats;
+
+// offset of the 8 byte little endian TSF timestamp in a beacon frame
+#define WIFI_BEACON_TSF_OFS 24
+
+// NAN discovery window interval, 512 TU
+#define NAN_DW_INTERVAL_US (512*1024)
+
+// offset of the RID vendor IE payload in a beacon frame from the library
+#define WIFI_BEACON_IE_OFS 58
+
+// window for the build rate statistics
+#define WIFI_BUILD_WINDOW_MS 5000
 
 bool WiFi_TX::init(void)
 {
@@ -39,83 +59,345 @@ bool WiFi_TX::init(void)
 
     memcpy(WiFi_mac_addr,mac_addr,6); //use generated random MAC address for OpenDroneID messages
 
-    esp_wifi_set_max_tx_power(dBm_to_tx_power(g.wifi_power));
+    nan_sync_length = odid_wifi_build_nan_sync_beacon_frame((char *)WiFi_mac_addr,
+                                                            nan_sync, sizeof(nan_sync));
+
+    beacon_rate = g.wifi_beacon_rate;
+    power = g.wifi_power;
+    esp_wifi_set_max_tx_power(dBm_to_tx_power(power));
 
     return true;
 }
 
-bool WiFi_TX::transmit_nan(ODID_UAS_Data &UAS_data)
+void WiFi_TX::set_profile(float _beacon_rate, float _power)
 {
-    init();
+    if (!initialised) {
+        return;
+    }
+    // the beacon interval in the frame follows the rate we send at
+    beacon_rate = _beacon_rate;
+    if (_power != power) {
+        power = _power;
+        esp_wifi_set_max_tx_power(dBm_to_tx_power(power));
+    }
+}
 
-    uint8_t buffer[1024] {};
+uint16_t WiFi_TX::beacon_interval_tu(void) const
+{
+    return 1000/beacon_rate;
+}
 
-    int length;
-    if ((length = odid_wifi_build_nan_sync_beacon_frame((char *)WiFi_mac_addr,
-                  buffer,sizeof(buffer))) > 0) {
-        if (esp_wifi_80211_tx(WIFI_IF_AP,buffer,length,true) != ESP_OK) {
-            return false;
+/*
+  build a frame with the opendroneid library, this encodes the messages
+  from UAS_data in msg_mask and the auth pages in auth_mask
+ */
+int WiFi_TX::build_frame(FrameType type, ODID_UAS_Data &UAS_data, uint8_t msg_mask, uint16_t auth_mask, uint8_t counter, uint8_t *buffer, size_t buflen)
+{
+    // large, so keep it off the radio task stack
+    static ODID_UAS_Data uas;
+    uas = UAS_data;
+#define MSG_VALID(m, v) ((msg_mask & (1U<<uint8_t(ODIDCache::Msg::m))) ? (v) : 0)
+    uas.BasicIDValid[0] = MSG_VALID(BASIC_ID_1, UAS_data.BasicIDValid[0]);
+    uas.BasicIDValid[1] = MSG_VALID(BASIC_ID_2, UAS_data.BasicIDValid[1]);
+    uas.LocationValid = MSG_VALID(LOCATION, UAS_data.LocationValid);
+    uas.SelfIDValid = MSG_VALID(SELF_ID, UAS_data.SelfIDValid);
+    uas.SystemValid = MSG_VALID(SYSTEM, UAS_data.SystemValid);
+    uas.OperatorIDValid = MSG_VALID(OPERATOR_ID, UAS_data.OperatorIDValid);
+#undef MSG_VALID
+    for (uint8_t i=0; i<ODID_AUTH_MAX_PAGES; i++) {
+        uas.AuthValid[i] = (auth_mask & (1U<<i)) ? UAS_data.AuthValid[i] : 0;
+    }
+
+    switch (type) {
+    case FrameType::NAN_ACTION:
+        return odid_wifi_build_message_pack_nan_action_frame(&uas,(char *)WiFi_mac_addr,
+                                                              counter,
+                                                              buffer,buflen);
+    case FrameType::BEACON:
+        return odid_wifi_build_message_pack_beacon_frame(&uas,(char *)WiFi_mac_addr,
+                                                          "UAS_ID_OPEN", strlen("UAS_ID_OPEN"), //use dummy SSID, as we only extract payload data
+                                                          beacon_interval_tu(), counter, buffer, buflen);
+    }
+    return -1;
+}
+
+/*
+  the template slot for a pack length, or the least recently used slot
+  to rebuild for it
+ */
+WiFi_TX::FrameTemplate &WiFi_TX::find_template(FrameTemplate *templates, FrameType type, int pack_len)
+{
+    const uint16_t interval_tu = type == FrameType::BEACON ? beacon_interval_tu() : 0;
+    FrameTemplate *ret = &templates[0];
+    for (uint8_t i=0; i<TEMPLATE_SLOTS; i++) {
+        auto &t = templates[i];
+        if (t.pack_len == pack_len && t.interval_tu == interval_tu) {
+            ret = &t;
+            break;
+        }
+        if (t.last_used < ret->last_used) {
+            ret = &t;
         }
     }
+    ret->last_used = ++template_uses;
+    return *ret;
+}
+
+/*
+  make sure we have a template for the current pack length. The
+  library builds the frame twice with different send counters, the
+  bytes that differ are the counters and the pack follows the first
+  counter. The pack in the frame must match the cached pack, otherwise
+  the template is not used. The beacon header carries a TSF timestamp
+  from the time of the build, and only the vendor IE after it is used,
+  so beacons are only compared from the IE onwards
+ */
+bool WiFi_TX::update_template(FrameTemplate &t, FrameType type, ODID_UAS_Data &UAS_data, uint8_t msg_mask, uint16_t auth_mask, const uint8_t *pack, int pack_len)
+{
+    const uint16_t interval_tu = type == FrameType::BEACON ? beacon_interval_tu() : 0;
+    if (t.pack_len == pack_len && t.interval_tu == interval_tu) {
+        return t.valid;
+    }
+    t.valid = false;
+    t.pack_len = pack_len;
+    t.interval_tu = interval_tu;
+
+    uint8_t other[sizeof(t.frame)];
+    memset(t.frame, 0, sizeof(t.frame));
+    memset(other, 0, sizeof(other));
+    t.length = build_frame(type, UAS_data, msg_mask, auth_mask, 0x00, t.frame, sizeof(t.frame));
+    const int length2 = build_frame(type, UAS_data, msg_mask, auth_mask, 0xFF, other, sizeof(other));
+    update_build_stats(0, t.length + length2);
+    if (t.length <= 0 || t.length != length2) {
+        return false;
+    }
 
-    if ((length = odid_wifi_build_message_pack_nan_action_frame(&UAS_data,(char *)WiFi_mac_addr,
-                  ++send_counter_nan,
-                  buffer,sizeof(buffer))) > 0) {
-        if (esp_wifi_80211_tx(WIFI_IF_AP,buffer,length,true) != ESP_OK) {
+    t.num_counters = 0;
+    const int start = type == FrameType::BEACON ? WIFI_BEACON_IE_OFS : 0;
+    for (int i=start; i<t.length; i++) {
+        if (t.frame[i] == other[i]) {
+            continue;
+        }
+        if (t.frame[i] != 0x00 || other[i] != 0xFF ||
+            t.num_counters >= ARRAY_SIZE(t.counter_ofs)) {
             return false;
         }
+        t.counter_ofs[t.num_counters++] = i;
+    }
+    if (t.num_counters == 0) {
+        return false;
     }
 
+    t.pack_ofs = t.counter_ofs[0] + 1;
+    if (t.pack_ofs + pack_len > t.length ||
+        memcmp(&t.frame[t.pack_ofs], pack, pack_len) != 0) {
+        return false;
+    }
+    t.valid = true;
     return true;
 }
 
-//update the payload of the beacon frames in this function
-bool WiFi_TX::transmit_beacon(ODID_UAS_Data &UAS_data)
+/*
+  build a frame using the encoded message cache, falling back to the
+  library if we can't make a template. The pack shaper picks the
+  messages and auth pages are added within the auth budget for the job.
+  The pack and send counters are patched into the template in place,
+  returns the frame or nullptr on error
+ */
+const uint8_t *WiFi_TX::build_from_cache(const ODIDCache &cache, FrameTemplate *templates, FrameType type, TxScheduler::Job job, ODID_UAS_Data &UAS_data, uint8_t counter, int &length)
+{
+    const uint8_t msg_mask = pack_shaper.select(job, cache);
+    const uint8_t msg_count = cache.num_available(msg_mask);
+    const uint16_t auth_mask = auth_pager.select(job, cache, msg_count, ODID_PACK_MAX_MESSAGES - msg_count);
+    uint8_t pack[sizeof(ODID_MessagePack_encoded)];
+    const int pack_len = cache.build_pack(pack, sizeof(pack), msg_mask, auth_mask);
+
+    auto &t = find_template(templates, type, pack_len);
+    if (pack_len <= 0 ||
+        !update_template(t, type, UAS_data, msg_mask, auth_mask, pack, pack_len)) {
+        // build in the slot, it is not a usable template for this length
+        last_template = nullptr;
+        t.valid = false;
+        if (pack_len <= 0) {
+            t.pack_len = -1;
+        }
+        length = build_frame(type, UAS_data, msg_mask, auth_mask, counter, t.frame, sizeof(t.frame));
+        update_build_stats(length, length);
+        return length > 0 ? t.frame : nullptr;
+    }
+    last_template = &t;
+    memcpy(&t.frame[t.pack_ofs], pack, pack_len);
+    for (uint8_t i=0; i<t.num_counters; i++) {
+        t.frame[t.counter_ofs[i]] = counter;
+    }
+    length = t.length;
+    update_build_stats(length, pack_len + t.num_counters);
+    return t.frame;
+}
+
+/*
+  update the frame build rates
+ */
+void WiFi_TX::update_build_stats(int frame_len, int written_len)
+{
+    if (frame_len > 0) {
+        frame_bytes += frame_len;
+    }
+    if (written_len > 0) {
+        written_bytes += written_len;
+    }
+    const uint32_t now_ms = millis();
+    const uint32_t dt_ms = now_ms - stats_start_ms;
+    if (dt_ms >= WIFI_BUILD_WINDOW_MS) {
+        build_stats.frame_Bps = frame_bytes * 1000.0 / dt_ms;
+        build_stats.written_Bps = written_bytes * 1000.0 / dt_ms;
+        frame_bytes = 0;
+        written_bytes = 0;
+        stats_start_ms = now_ms;
+    }
+}
+
+bool WiFi_TX::transmit_nan(ODID_UAS_Data &UAS_data, const ODIDCache &cache)
 {
     init();
 
-    uint8_t buffer[1024] {};
+    if (!transmit_nan_sync()) {
+        return false;
+    }
 
+    // the 802.11 sequence number is filled in by the WiFi stack
     int length;
-    if ((length = odid_wifi_build_message_pack_beacon_frame(&UAS_data,(char *)WiFi_mac_addr,
-                   "UAS_ID_OPEN", strlen("UAS_ID_OPEN"), //use dummy SSID, as we only extract payload data
-                  1000/g.wifi_beacon_rate, ++send_counter_beacon, buffer, sizeof(buffer))) > 0) {
-
-        //set the RID IE element
-        uint8_t header_offset = 58;
-        vendor_ie_data_t IE_data;
-        IE_data.element_id = WIFI_VENDOR_IE_ELEMENT_ID;
-        IE_data.vendor_oui[0] = 0xFA;
-        IE_data.vendor_oui[1] = 0x0B;
-        IE_data.vendor_oui[2] = 0xBC;
-        IE_data.vendor_oui_type = 0x0D;
-        IE_data.length = length - header_offset + 4; //add 4 as of definition esp_wifi_set_vendor_ie
-        memcpy(IE_data.payload,&buffer[header_offset],length - header_offset);
-
-        // so first remove old element, add new afterwards
-        if (esp_wifi_set_vendor_ie(false, WIFI_VND_IE_TYPE_BEACON, WIFI_VND_IE_ID_0, &IE_data) != ESP_OK){
+    const uint8_t *frame = build_from_cache(cache, nan_templates, FrameType::NAN_ACTION, TxScheduler::Job::WIFI_NAN, UAS_data,
+                                            ++send_counter_nan, length);
+    if (frame != nullptr) {
+        if (esp_wifi_80211_tx(WIFI_IF_AP,frame,length,true) != ESP_OK) {
             return false;
         }
+        nan_stats.action_sent++;
+    }
 
-        if (esp_wifi_set_vendor_ie(true, WIFI_VND_IE_TYPE_BEACON, WIFI_VND_IE_ID_0, &IE_data) != ESP_OK){
-            return false;
-        }
+    return true;
+}
+
+/*
+  send the NAN sync beacon ahead of an action frame, with its timestamp
+  set to the current time. With WIFI_NAN_SYNC set it is only sent once
+  that many discovery windows have passed
+ */
+bool WiFi_TX::transmit_nan_sync(void)
+{
+    if (nan_sync_length <= 0) {
+        return true;
+    }
+    const uint32_t now_ms = millis();
+    if (g.wifi_nan_sync > 0 && nan_stats.sync_sent > 0 &&
+        now_ms - nan_sync_ms < g.wifi_nan_sync * (NAN_DW_INTERVAL_US/1000)) {
+        return true;
+    }
+    if (nan_sync_length < WIFI_BEACON_TSF_OFS + 8) {
+        return false;
+    }
+    uint64_t tsf = esp_timer_get_time();
+    for (uint8_t i=0; i<8; i++) {
+        nan_sync[WIFI_BEACON_TSF_OFS+i] = uint8_t(tsf);
+        tsf >>= 8;
+    }
+    if (esp_wifi_80211_tx(WIFI_IF_AP,nan_sync,nan_sync_length,true) != ESP_OK) {
+        return false;
+    }
+    nan_sync_ms = now_ms;
+    nan_stats.sync_sent++;
+    return true;
+}
+
+//update the payload of the beacon frames in this function
+bool WiFi_TX::transmit_beacon(ODID_UAS_Data &UAS_data, const ODIDCache &cache)
+{
+    init();
+
+    int length;
+    const uint8_t *buffer = build_from_cache(cache, beacon_templates, FrameType::BEACON, TxScheduler::Job::WIFI_BEACON, UAS_data,
+                                             ++send_counter_beacon, length);
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    //set the RID IE element
+    const uint8_t header_offset = WIFI_BEACON_IE_OFS;
+    const int ie_len = length - header_offset;
+    if (ie_len <= 0 || ie_len > IE_PAYLOAD_MAX) {
+        return false;
+    }
+
+    if (beacon_ie_set && same_ie(&buffer[header_offset], ie_len, header_offset)) {
+        // the installed IE only differs in the send counter
+        ie_stats.skipped++;
+        return true;
+    }
+
+    auto &ie = beacon_ie();
+    ie.element_id = WIFI_VENDOR_IE_ELEMENT_ID;
+    ie.vendor_oui[0] = 0xFA;
+    ie.vendor_oui[1] = 0x0B;
+    ie.vendor_oui[2] = 0xBC;
+    ie.vendor_oui_type = 0x0D;
+    ie.length = ie_len + 4; //add 4 as of definition esp_wifi_set_vendor_ie
+    memcpy(ie.payload,&buffer[header_offset],ie_len);
 
-        //set the payload also to probe requests, to increase update rate on mobile phones
-        // so first remove old element, add new afterwards
-        if (esp_wifi_set_vendor_ie(false, WIFI_VND_IE_TYPE_PROBE_RESP, WIFI_VND_IE_ID_0, &IE_data) != ESP_OK){
+    //set the payload also to probe requests, to increase update rate on mobile phones
+    if (!set_vendor_ie(WIFI_VND_IE_TYPE_BEACON) ||
+        !set_vendor_ie(WIFI_VND_IE_TYPE_PROBE_RESP)) {
+        beacon_ie_set = false;
+        return false;
+    }
+    beacon_ie_set = true;
+    return true;
+}
+
+/*
+  true if a new vendor IE payload matches the installed one apart from
+  the send counters of the template it was built from
+ */
+bool WiFi_TX::same_ie(const uint8_t *payload, int len, uint8_t header_offset) const
+{
+    if (beacon_ie().length != len + 4) {
+        return false;
+    }
+    uint16_t skip[ARRAY_SIZE(last_template->counter_ofs)];
+    uint8_t num_skip = 0;
+    if (last_template != nullptr) {
+        for (uint8_t i=0; i<last_template->num_counters; i++) {
+            if (last_template->counter_ofs[i] >= header_offset &&
+                last_template->counter_ofs[i] < header_offset + len) {
+                skip[num_skip++] = last_template->counter_ofs[i] - header_offset;
+            }
+        }
+    }
+    int ofs = 0;
+    for (uint8_t i=0; i<=num_skip; i++) {
+        const int end = i < num_skip ? skip[i] : len;
+        if (end > ofs && memcmp(&beacon_ie().payload[ofs], &payload[ofs], end - ofs) != 0) {
             return false;
         }
+        ofs = end + 1;
+    }
+    return true;
+}
 
-        if (esp_wifi_set_vendor_ie(true, WIFI_VND_IE_TYPE_PROBE_RESP, WIFI_VND_IE_ID_0, &IE_data) != ESP_OK){
+/*
+  install the beacon vendor IE for a frame type. The old IE is removed
+  first unless OPTIONS_WIFI_IE_REPLACE says the WiFi stack replaces it
+ */
+bool WiFi_TX::set_vendor_ie(wifi_vendor_ie_type_t type)
+{
+    if (beacon_ie_set && !(g.options & OPTIONS_WIFI_IE_REPLACE)) {
+        ie_stats.calls++;
+        if (esp_wifi_set_vendor_ie(false, type, WIFI_VND_IE_ID_0, &beacon_ie()) != ESP_OK) {
             return false;
         }
-
-        return true;
-	}
-	else {
-		return false;
-	}
+    }
+    ie_stats.calls++;
+    return esp_wifi_set_vendor_ie(true, type, WIFI_VND_IE_ID_0, &beacon_ie()) == ESP_OK;
 }
 
 
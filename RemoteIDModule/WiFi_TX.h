@@ -4,19 +4,139 @@
 #pragma once
 
 #include "transmitter.h"
+#include "odid_cache.h"
+#include "scheduler.h"
+#include <esp_wifi.h>
 
 class WiFi_TX : public Transmitter {
 public:
     bool init(void) override;
-    bool transmit_nan(ODID_UAS_Data &UAS_data);
-    bool transmit_beacon(ODID_UAS_Data &UAS_data);
+    bool transmit_nan(ODID_UAS_Data &UAS_data, const ODIDCache &cache);
+    bool transmit_beacon(ODID_UAS_Data &UAS_data, const ODIDCache &cache);
+
+    /*
+      set the beacon rate and power for a broadcast profile, the power
+      is applied immediately if it has changed
+     */
+    void set_profile(float beacon_rate, float power);
+
+    /*
+      bytes per second of the frames we send, and of the bytes we
+      write to build them. With the templates only the pack and
+      counters are written for most frames
+     */
+    struct BuildStats {
+        float frame_Bps;
+        float written_Bps;
+    };
+
+    static const BuildStats &get_build_stats(void) {
+        return build_stats;
+    }
+
+    // NAN frames handed to the WiFi stack
+    struct NanStats {
+        uint32_t sync_sent;
+        uint32_t action_sent;
+    };
+
+    static const NanStats &get_nan_stats(void) {
+        return nan_stats;
+    }
+
+    // esp_wifi_set_vendor_ie() calls, and beacon updates skipped as unchanged
+    struct IEStats {
+        uint32_t calls;
+        uint32_t skipped;
+    };
+
+    static const IEStats &get_ie_stats(void) {
+        return ie_stats;
+    }
 
 private:
     bool initialised;
+    float beacon_rate;
+    float power;
     char ssid[32];
     uint8_t WiFi_mac_addr[6];
     size_t ssid_length;
     uint8_t send_counter_nan;
+
+    /*
+      the NAN sync beacon is built once for our MAC, only its timestamp
+      is patched before each send
+     */
+    uint8_t nan_sync[256];
+    int nan_sync_length;
+    uint32_t nan_sync_ms;
+    static NanStats nan_stats;
+    bool transmit_nan_sync(void);
+
     uint8_t send_counter_beacon;
     uint8_t dBm_to_tx_power(float dBm) const;
+
+    enum class FrameType : uint8_t {
+        NAN_ACTION,
+        BEACON,
+    };
+
+    /*
+      a frame as built by the opendroneid library for a given pack
+      length, with the offsets of the message pack and send counters so
+      a new pack from the encoded message cache can be patched in place
+      without the library encoding every message again
+     */
+    struct FrameTemplate {
+        uint8_t frame[512];
+        int length;
+        int pack_len;
+        uint16_t interval_tu;
+        uint16_t pack_ofs;
+        uint16_t counter_ofs[4];
+        uint8_t num_counters;
+        bool valid;
+        uint32_t last_used;
+    };
+
+    /*
+      pack shaping and auth pages give packs of a few lengths, so we
+      keep the most recently used templates for each frame type
+     */
+    static const uint8_t TEMPLATE_SLOTS = 3;
+    FrameTemplate nan_templates[TEMPLATE_SLOTS];
+    FrameTemplate beacon_templates[TEMPLATE_SLOTS];
+    uint32_t template_uses;
+    // the template of the last frame built, nullptr if built by the library
+    const FrameTemplate *last_template;
+
+    /*
+      the installed beacon and probe response vendor IE. The IDF
+      declares the payload as a zero length array, so the storage for
+      it follows the header
+     */
+    static const uint8_t IE_PAYLOAD_MAX = 255 - 4;
+    uint8_t beacon_ie_buf[sizeof(vendor_ie_data_t) + IE_PAYLOAD_MAX];
+    vendor_ie_data_t &beacon_ie(void) {
+        return *(vendor_ie_data_t *)beacon_ie_buf;
+    }
+    const vendor_ie_data_t &beacon_ie(void) const {
+        return *(const vendor_ie_data_t *)beacon_ie_buf;
+    }
+    bool beacon_ie_set;
+    static IEStats ie_stats;
+    bool same_ie(const uint8_t *payload, int len, uint8_t header_offset) const;
+    bool set_vendor_ie(wifi_vendor_ie_type_t type);
+
+    static BuildStats build_stats;
+    uint32_t frame_bytes;
+    uint32_t written_bytes;
+    uint32_t stats_start_ms;
+    void update_build_stats(int frame_len, int written_len);
+
+    uint16_t beacon_interval_tu(void) const;
+    int build_frame(FrameType type, ODID_UAS_Data &UAS_data, uint8_t msg_mask, uint16_t auth_mask, uint8_t counter, uint8_t *buffer, size_t buflen);
+    FrameTemplate &find_template(FrameTemplate *templates, FrameType type, int pack_len);
+    bool update_template(FrameTemplate &t, FrameType type, ODID_UAS_Data &UAS_data, uint8_t msg_mask, uint16_t auth_mask, const uint8_t *pack, int pack_len);
+    const uint8_t *build_from_cache(const ODIDCache &cache, FrameTemplate *templates, FrameType type, TxScheduler::Job job, ODID_UAS_Data &UAS_data, uint8_t counter, int &length);
 };
@@ -0,0 +1,67 @@
+/*
+  scheduling of the authentication pages into the broadcasts
+
+  auth data can run to many pages, which would take a lot of airtime
+  if every page went out with every message pack. Instead each job
+  sends the pages in turn, and AUTH_BUDGET limits the percentage of
+  the messages a job sends that may be auth pages. BT4 legacy sends an
+  auth page in place of one of its frames, the message packs add
+  pages in their free slots
+ */
+#include <Arduino.h>
+#include "auth_pager.h"
+#include "parameters.h"
+
+AuthPager auth_pager;
+
+uint16_t AuthPager::select(TxScheduler::Job job, const ODIDCache &cache, uint8_t msg_count, uint8_t max_pages)
+{
+    auto &j = jobs[uint8_t(job)];
+    const uint8_t num_pages = cache.auth_pages();
+    if (num_pages == 0 || g.auth_budget <= 0) {
+        return 0;
+    }
+
+    // start a new auth sequence from its first page
+    const uint32_t generation = cache.get_auth_generation();
+    if (generation != j.generation) {
+        j.generation = generation;
+        j.next_page = 0;
+        j.cycle_start_ms = 0;
+        j.cycle_ms = 0;
+    }
+    if (j.next_page >= num_pages) {
+        j.next_page = 0;
+    }
+
+    /*
+      keep the auth pages at the budget fraction of the messages we
+      send, with no more than one cycle saved up
+     */
+    const float budget = g.auth_budget * 0.01;
+    if (msg_count == 0) {
+        j.credit += budget;
+    } else {
+        j.credit += msg_count * budget / (1 - budget);
+    }
+    if (j.credit > num_pages) {
+        j.credit = num_pages;
+    }
+
+    uint16_t mask = 0;
+    const uint32_t now_ms = millis();
+    while (j.credit >= 1 && max_pages > 0 && (mask & (1U<<j.next_page)) == 0) {
+        if (j.next_page == 0) {
+            if (j.cycle_start_ms != 0) {
+                j.cycle_ms = now_ms - j.cycle_start_ms;
+            }
+            j.cycle_start_ms = now_ms;
+        }
+        mask |= 1U<<j.next_page;
+        j.next_page = (j.next_page + 1) % num_pages;
+        j.credit -= 1;
+        max_pages--;
+        pages_sent++;
+    }
+    return mask;
+}
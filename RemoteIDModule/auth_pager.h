@@ -0,0 +1,44 @@
+/*
+  scheduling of the authentication pages into the broadcasts
+ */
+#pragma once
+
+#include <stdint.h>
+#include "scheduler.h"
+#include "odid_cache.h"
+
+class AuthPager {
+public:
+    /*
+      choose the auth pages to add to a transmit on a job, which
+      carries msg_count other messages and has room for max_pages
+      pages. msg_count is 0 for a BT4 legacy frame, where a page takes
+      the place of a message. Returns a mask of the pages, empty if
+      the airtime budget has no room. Each job sends the pages in
+      turn, carrying on from where its last transmit left off
+     */
+    uint16_t select(TxScheduler::Job job, const ODIDCache &cache, uint8_t msg_count, uint8_t max_pages);
+
+    // time for the last full cycle through the pages on a job, 0 if none yet
+    uint32_t get_cycle_ms(TxScheduler::Job job) const {
+        return jobs[uint8_t(job)].cycle_ms;
+    }
+
+    // number of pages sent on all jobs
+    uint32_t get_pages_sent(void) const {
+        return pages_sent;
+    }
+
+private:
+    struct {
+        // pages the budget allows, builds up with each other message
+        float credit;
+        uint8_t next_page;
+        uint32_t generation;
+        uint32_t cycle_start_ms;
+        uint32_t cycle_ms;
+    } jobs[uint8_t(TxScheduler::Job::NUM_JOBS)];
+    uint32_t pages_sent;
+};
+
+extern AuthPager auth_pager;
@@ -164,6 +164,13 @@
 #define CAN_TERM_EN  LOW
 #define CAN_APP_NODE_NAME "net.cuav.c-rid"
 
+#elif defined(BOARD_HOST)
+// Linux host build for benchmarking and simulation, see host/
+#define BOARD_ID 0
+
+#define PIN_UART_TX 1
+#define PIN_UART_RX 3
+
 #else
 #error "unsupported board"
 #endif
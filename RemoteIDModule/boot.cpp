@@ -0,0 +1,79 @@
+/*
+  boot timeline
+
+  the phases are timestamped with esp_timer, which starts counting
+  early in application startup, so the times include the ESP-IDF and
+  Arduino startup before setup() is called
+ */
+#include <Arduino.h>
+#include "boot.h"
+#include <esp_timer.h>
+
+BootTimeline boot;
+
+/*
+  the longest we hold back the slow startup work waiting for the first
+  frame, we may not broadcast until we have a location
+ */
+#define BOOT_DEFER_MAX_MS 3000
+
+const char *BootTimeline::phase_name(Phase phase)
+{
+    switch (phase) {
+    case Phase::PARAMS:
+        return "PARAMS";
+    case Phase::SERIAL_PORTS:
+        return "SERIAL";
+    case Phase::TRANSPORTS:
+        return "TRANSPORTS";
+    case Phase::SETUP:
+        return "SETUP";
+    case Phase::RADIO_INIT:
+        return "RADIO_INIT";
+    case Phase::FIRST_TX:
+        return "FIRST_TX";
+    case Phase::WEBSERVER:
+        return "WEBSERVER";
+    case Phase::FW_CHECK:
+        return "FW_CHECK";
+    default:
+        break;
+    }
+    return "UNKNOWN";
+}
+
+void BootTimeline::mark(Phase phase)
+{
+    auto &t = phase_us[uint8_t(phase)];
+    if (t.load(std::memory_order_relaxed) != 0) {
+        return;
+    }
+    uint32_t now_us = uint32_t(esp_timer_get_time());
+    if (now_us == 0) {
+        now_us = 1;
+    }
+    uint32_t expected = 0;
+    t.compare_exchange_strong(expected, now_us, std::memory_order_relaxed);
+}
+
+bool BootTimeline::broadcast_started(void) const
+{
+    if (!marked(Phase::RADIO_INIT)) {
+        return false;
+    }
+    return marked(Phase::FIRST_TX) || millis() >= BOOT_DEFER_MAX_MS;
+}
+
+void BootTimeline::print(void) const
+{
+    Serial.printf("Boot timeline:\n");
+    for (uint8_t i=0; i<uint8_t(Phase::NUM_PHASES); i++) {
+        const Phase phase = Phase(i);
+        const uint32_t t_us = get_us(phase);
+        if (t_us == 0) {
+            Serial.printf("  %-10s -\n", phase_name(phase));
+        } else {
+            Serial.printf("  %-10s %.1f ms\n", phase_name(phase), t_us*0.001);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+/*
+  boot timeline, time from power on to the end of each startup phase
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+class BootTimeline {
+public:
+    enum class Phase : uint8_t {
+        PARAMS=0,       // parameters loaded from NVS
+        SERIAL_PORTS,   // serial ports open
+        TRANSPORTS,     // MAVLink and DroneCAN ready
+        SETUP,          // setup() complete
+        RADIO_INIT,     // BLE and WiFi up, in the radio task
+        FIRST_TX,       // first Remote ID frame sent
+        WEBSERVER,      // web server started, in the background
+        FW_CHECK,       // firmware signature checked, in the background
+        NUM_PHASES
+    };
+
+    /*
+      record the end of a phase, only the first call for each phase
+      is kept. May be called from any task
+     */
+    void mark(Phase phase);
+
+    bool marked(Phase phase) const {
+        return get_us(phase) != 0;
+    }
+
+    // microseconds from boot to the end of a phase, 0 if not reached
+    uint32_t get_us(Phase phase) const {
+        return phase_us[uint8_t(phase)].load(std::memory_order_relaxed);
+    }
+
+    /*
+      true once the radios are up and broadcasting has begun, or we
+      have given up waiting for it. Slow startup work waits for this
+     */
+    bool broadcast_started(void) const;
+
+    // print the timeline on the debug serial port
+    void print(void) const;
+
+    static const char *phase_name(Phase phase);
+
+private:
+    std::atomic<uint32_t> phase_us[uint8_t(Phase::NUM_PHASES)];
+};
+
+extern BootTimeline boot;
@@ -0,0 +1,49 @@
+/*
+  emergency fast path
+
+  when the flight controller declares an emergency every enabled radio
+  sends immediately, out of its normal cycle, and the transmit rates
+  are raised for a burst window so receivers pick up the change
+  quickly
+ */
+#include <Arduino.h>
+#include "emergency.h"
+#include <esp_timer.h>
+
+EmergencyBurst emergency;
+
+// transmit rate multiplier during a burst
+#define EMERGENCY_RATE_MULT 4
+
+void EmergencyBurst::start(uint32_t count, int64_t _rx_us, float burst_s)
+{
+    last_count = count;
+    rx_us = _rx_us;
+    burst_start_ms = millis();
+    burst_ms = burst_s * 1000;
+    pending_mask = (1U<<uint8_t(TxScheduler::Job::NUM_JOBS))-1;
+    memset(stats.latency_us, 0, sizeof(stats.latency_us));
+    stats.count++;
+}
+
+float EmergencyBurst::rate_scale(void) const
+{
+    if (stats.count == 0 || millis() - burst_start_ms >= burst_ms) {
+        return 1;
+    }
+    return EMERGENCY_RATE_MULT;
+}
+
+void EmergencyBurst::sent(TxScheduler::Job job)
+{
+    const uint8_t mask = 1U<<uint8_t(job);
+    if ((pending_mask & mask) == 0) {
+        return;
+    }
+    pending_mask &= ~mask;
+    const uint32_t latency_us = uint32_t(esp_timer_get_time() - rx_us);
+    stats.latency_us[uint8_t(job)] = latency_us;
+    if (latency_us > stats.latency_max_us) {
+        stats.latency_max_us = latency_us;
+    }
+}
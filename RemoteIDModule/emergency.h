@@ -0,0 +1,54 @@
+/*
+  emergency fast path for the radio task
+ */
+#pragma once
+
+#include <stdint.h>
+#include "scheduler.h"
+
+class EmergencyBurst {
+public:
+    // true if count is an emergency we have not yet started a burst for
+    bool is_new(uint32_t count) const {
+        return count != last_count;
+    }
+
+    /*
+      start a burst for a new emergency. rx_us is the esp_timer time
+      the transport received it, burst_s the time to run at the raised
+      rates
+     */
+    void start(uint32_t count, int64_t rx_us, float burst_s);
+
+    // multiplier for the transmit rates, raised during a burst
+    float rate_scale(void) const;
+
+    /*
+      a frame was sent for a job, measures the latency of the first
+      frame for each job after an emergency starts
+     */
+    void sent(TxScheduler::Job job);
+
+    struct Stats {
+        uint32_t count;
+        // latency from the transport to the first frame of the last
+        // emergency, 0 if none sent yet
+        uint32_t latency_us[uint8_t(TxScheduler::Job::NUM_JOBS)];
+        uint32_t latency_max_us;
+    };
+
+    const Stats &get_stats(void) const {
+        return stats;
+    }
+
+private:
+    uint32_t last_count;
+    int64_t rx_us;
+    uint32_t burst_start_ms;
+    uint32_t burst_ms;
+    // jobs still waiting for their first emergency frame
+    uint8_t pending_mask;
+    Stats stats;
+};
+
+extern EmergencyBurst emergency;
@@ -0,0 +1,83 @@
+/*
+  dead reckoning of the Location message
+
+  the flight controller may send its location at a lower rate than we
+  broadcast, so each frame would carry a position up to a full update
+  period old. The radio task projects the last location forward to
+  the time of the transmit, holding the position at the horizon so a
+  lost link can't run it away
+ */
+#include <Arduino.h>
+#include "extrapolate.h"
+#include <math.h>
+
+LocationExtrapolator extrapolator;
+
+// below this age the projection is within the message resolution
+#define EXTRAPOLATE_MIN_MS 50
+
+#define EARTH_RADIUS_M 6378137.0
+#define DEG_RAD (M_PI/180.0)
+
+bool LocationExtrapolator::project(ODID_Location_data &loc, uint32_t age_ms, float horizon_s)
+{
+    if (horizon_s <= 0 || age_ms < EXTRAPOLATE_MIN_MS) {
+        return false;
+    }
+    if (loc.Status != ODID_STATUS_AIRBORNE && loc.Status != ODID_STATUS_EMERGENCY) {
+        return false;
+    }
+    if (loc.Latitude == 0 && loc.Longitude == 0) {
+        return false;
+    }
+    const uint32_t horizon_ms = horizon_s * 1000;
+    if (age_ms > horizon_ms) {
+        age_ms = horizon_ms;
+    }
+    const float dt = age_ms * 0.001;
+
+    if (loc.Direction >= 0 && loc.Direction <= MAX_DIR &&
+        loc.SpeedHorizontal > 0 && loc.SpeedHorizontal <= MAX_SPEED_H) {
+        const double dist_m = loc.SpeedHorizontal * dt;
+        const double dir_rad = loc.Direction * DEG_RAD;
+        const double north_m = dist_m * cos(dir_rad);
+        const double east_m = dist_m * sin(dir_rad);
+        const double lat = loc.Latitude + north_m / (EARTH_RADIUS_M * DEG_RAD);
+        const double cos_lat = cos(loc.Latitude * DEG_RAD);
+        if (fabs(lat) <= 90 && cos_lat > 0.01) {
+            double lon = loc.Longitude + east_m / (EARTH_RADIUS_M * cos_lat * DEG_RAD);
+            if (lon > 180) {
+                lon -= 360;
+            } else if (lon < -180) {
+                lon += 360;
+            }
+            loc.Latitude = lat;
+            loc.Longitude = lon;
+        }
+    }
+
+    if (loc.SpeedVertical >= MIN_SPEED_V && loc.SpeedVertical <= MAX_SPEED_V) {
+        const float climb_m = loc.SpeedVertical * dt;
+        if (loc.AltitudeBaro > INV_ALT) {
+            loc.AltitudeBaro = constrain(loc.AltitudeBaro + climb_m, float(MIN_ALT)+1, MAX_ALT);
+        }
+        if (loc.AltitudeGeo > INV_ALT) {
+            loc.AltitudeGeo = constrain(loc.AltitudeGeo + climb_m, float(MIN_ALT)+1, MAX_ALT);
+        }
+        if (loc.Height > INV_ALT) {
+            loc.Height = constrain(loc.Height + climb_m, float(MIN_ALT)+1, MAX_ALT);
+        }
+    }
+
+    if (loc.TimeStamp >= 0 && loc.TimeStamp <= MAX_TIMESTAMP) {
+        // seconds after the hour
+        loc.TimeStamp = fmodf(loc.TimeStamp + dt, MAX_TIMESTAMP);
+    }
+
+    stats.count++;
+    stats.last_ms = age_ms;
+    if (age_ms > stats.max_ms) {
+        stats.max_ms = age_ms;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+/*
+  dead reckoning of the Location message between flight controller
+  updates
+ */
+#pragma once
+
+#include <stdint.h>
+#include <opendroneid.h>
+
+class LocationExtrapolator {
+public:
+    /*
+      project loc forward by age_ms using its direction, horizontal
+      speed and vertical speed, limited to horizon_s. Returns false if
+      loc can't be extrapolated, leaving it unchanged
+     */
+    bool project(ODID_Location_data &loc, uint32_t age_ms, float horizon_s);
+
+    struct Stats {
+        uint32_t count;
+        uint32_t last_ms;
+        uint32_t max_ms;
+    };
+
+    const Stats &get_stats(void) const {
+        return stats;
+    }
+
+private:
+    Stats stats;
+};
+
+extern LocationExtrapolator extrapolator;
@@ -0,0 +1,162 @@
+/*
+  minimal Arduino API for the Linux host build
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_system.h"
+
+typedef bool boolean;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield(void);
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// glibc 2.38 and later provide these
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 38)
+#define HOST_NEED_STRLCPY 1
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+#endif
+
+class String {
+public:
+    String(const char *s="") : str(s?s:"") {}
+    String(const std::string &s) : str(s) {}
+    String(char c) : str(1, c) {}
+    String(int v, unsigned char base=10) : str(fmt_int(v, base)) {}
+    String(unsigned v, unsigned char base=10) : str(fmt_uint(v, base)) {}
+    String(long v, unsigned char base=10) : str(fmt_int(v, base)) {}
+    String(unsigned long v, unsigned char base=10) : str(fmt_uint(v, base)) {}
+    String(float v, unsigned int decimals=2) : str(fmt_float(v, decimals)) {}
+    String(double v, unsigned int decimals=2) : str(fmt_float(v, decimals)) {}
+
+    String &operator+=(const String &s) { str += s.str; return *this; }
+    String &operator+=(const char *s) { str += s; return *this; }
+    String &operator+=(char c) { str += c; return *this; }
+    friend String operator+(const String &a, const String &b) { return String(a.str + b.str); }
+    friend String operator+(const String &a, const char *b) { return String(a.str + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.str); }
+    bool operator==(const String &s) const { return str == s.str; }
+    bool operator!=(const String &s) const { return str != s.str; }
+    bool operator==(const char *s) const { return str == s; }
+    bool operator!=(const char *s) const { return str != s; }
+    bool operator==(std::nullptr_t) const { return false; }
+    bool operator!=(std::nullptr_t) const { return true; }
+
+    const char *c_str() const { return str.c_str(); }
+    unsigned length() const { return str.length(); }
+    void reserve(unsigned n) { str.reserve(n); }
+    bool endsWith(const String &s) const {
+        return str.size() >= s.str.size() && str.compare(str.size()-s.str.size(), s.str.size(), s.str) == 0;
+    }
+    void replace(const String &from, const String &to);
+
+private:
+    std::string str;
+    static std::string fmt_int(long v, unsigned char base);
+    static std::string fmt_uint(unsigned long v, unsigned char base);
+    static std::string fmt_float(double v, unsigned int decimals);
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+    virtual size_t readBytes(char *buffer, size_t length);
+};
+
+#define SERIAL_8N1 0x800001c
+
+/*
+  serial port with in memory buffers. Bytes written by the firmware go
+  to the console for Serial and are discarded for other ports, bytes
+  queued with host_inject() are read by the firmware
+ */
+class HardwareSerial : public Stream {
+public:
+    HardwareSerial(uint8_t _num) : num(_num) {}
+    void begin(unsigned long baud, uint32_t config=SERIAL_8N1, int8_t rxPin=-1, int8_t txPin=-1);
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    // host only, queue bytes to be read by the firmware
+    void host_inject(const uint8_t *buf, size_t len);
+    // host only, total bytes written by the firmware
+    uint64_t host_tx_bytes(void) const { return tx_bytes; }
+
+private:
+    uint8_t num;
+    uint64_t tx_bytes;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+class EspClass {
+public:
+    uint32_t getFreeHeap(void);
+    uint32_t getCycleCount(void);
+    uint32_t getCpuFreqMHz(void) { return HOST_CPU_MHZ; }
+    void restart(void);
+    // cycle counter is emulated at this rate
+    static const uint32_t HOST_CPU_MHZ = 240;
+};
+extern EspClass ESP;
+
+uint32_t getCpuFrequencyMhz(void);
+
+enum gpio_num_t {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_1,
+    GPIO_NUM_2,
+    GPIO_NUM_3,
+    GPIO_NUM_4,
+    GPIO_NUM_5,
+    GPIO_NUM_6,
+    GPIO_NUM_7,
+    GPIO_NUM_8,
+    GPIO_NUM_9,
+    GPIO_NUM_10,
+    GPIO_NUM_MAX = 49,
+};
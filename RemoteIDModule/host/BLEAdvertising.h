@@ -0,0 +1,22 @@
+/*
+  Arduino BLE multi advertising for the Linux host build, advertising
+  data is captured by host_radio.cpp
+ */
+#pragma once
+
+#include "BLEDevice.h"
+
+class BLEMultiAdvertising {
+public:
+    BLEMultiAdvertising(uint8_t num=1);
+    bool setAdvertisingData(uint8_t instance, uint16_t length, const uint8_t *data);
+    bool setAdvertisingParams(uint8_t instance, const esp_ble_gap_ext_adv_params_t *params);
+    bool setInstanceAddress(uint8_t instance, uint8_t *rand_addr);
+    bool setDuration(uint8_t instance, int duration=0, int max_events=0);
+    bool start(void);
+    bool start(uint8_t num, uint8_t from);
+    bool stop(uint8_t num_adv, const uint8_t *ext_adv_inst);
+
+private:
+    uint8_t count;
+};
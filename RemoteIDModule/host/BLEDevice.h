@@ -0,0 +1,119 @@
+/*
+  Arduino BLE device and ESP-IDF GAP definitions for the Linux host
+  build
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PWR_LVL_N12 = 0,
+    ESP_PWR_LVL_N9,
+    ESP_PWR_LVL_N6,
+    ESP_PWR_LVL_N3,
+    ESP_PWR_LVL_N0,
+    ESP_PWR_LVL_P3,
+    ESP_PWR_LVL_P6,
+    ESP_PWR_LVL_P9,
+    ESP_PWR_LVL_P12,
+    ESP_PWR_LVL_P15,
+    ESP_PWR_LVL_P18,
+    ESP_PWR_LVL_N27,
+    ESP_PWR_LVL_N24,
+    ESP_PWR_LVL_N21,
+    ESP_PWR_LVL_N18,
+    ESP_PWR_LVL_N15,
+} esp_power_level_t;
+
+typedef uint16_t esp_ble_ext_adv_type_mask_t;
+#define ESP_BLE_GAP_SET_EXT_ADV_PROP_NONCONN_NONSCANNABLE_UNDIRECTED 0x0000
+#define ESP_BLE_GAP_SET_EXT_ADV_PROP_LEGACY 0x0010
+#define ESP_BLE_GAP_SET_EXT_ADV_PROP_LEGACY_NONCONN (ESP_BLE_GAP_SET_EXT_ADV_PROP_LEGACY)
+
+typedef enum {
+    ADV_CHNL_37 = 0x01,
+    ADV_CHNL_38 = 0x02,
+    ADV_CHNL_39 = 0x04,
+    ADV_CHNL_ALL = 0x07,
+} esp_ble_adv_channel_t;
+
+typedef enum {
+    BLE_ADDR_TYPE_PUBLIC = 0,
+    BLE_ADDR_TYPE_RANDOM,
+} esp_ble_addr_type_t;
+
+typedef enum {
+    ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY = 0,
+    ADV_FILTER_ALLOW_SCAN_WLST_CON_ANY,
+    ADV_FILTER_ALLOW_SCAN_ANY_CON_WLST,
+    ADV_FILTER_ALLOW_SCAN_WLST_CON_WLST,
+} esp_ble_adv_filter_t;
+
+typedef uint8_t esp_ble_gap_phy_t;
+#define ESP_BLE_GAP_PHY_1M 1
+#define ESP_BLE_GAP_PHY_2M 2
+#define ESP_BLE_GAP_PHY_CODED 3
+
+typedef uint8_t esp_ble_gap_prefer_phy_options_t;
+#define ESP_BLE_GAP_PHY_OPTIONS_PREF_S2_CODING 1
+#define ESP_BLE_GAP_PHY_OPTIONS_PREF_S8_CODING 2
+
+#define ESP_BLE_AD_TYPE_NAME_SHORT 0x08
+
+typedef uint8_t esp_bd_addr_t[6];
+
+typedef struct {
+    esp_ble_ext_adv_type_mask_t type;
+    uint32_t interval_min;
+    uint32_t interval_max;
+    esp_ble_adv_channel_t channel_map;
+    esp_ble_addr_type_t own_addr_type;
+    esp_ble_addr_type_t peer_addr_type;
+    esp_bd_addr_t peer_addr;
+    esp_ble_adv_filter_t filter_policy;
+    int8_t tx_power;
+    esp_ble_gap_phy_t primary_phy;
+    uint8_t max_skip;
+    esp_ble_gap_phy_t secondary_phy;
+    uint8_t sid;
+    bool scan_req_notif;
+} esp_ble_gap_ext_adv_params_t;
+
+esp_err_t esp_ble_gap_set_prefered_default_phy(esp_ble_gap_prefer_phy_options_t tx_phy_mask,
+                                               esp_ble_gap_prefer_phy_options_t rx_phy_mask);
+
+typedef enum {
+    ESP_BT_STATUS_SUCCESS = 0,
+    ESP_BT_STATUS_FAIL,
+} esp_bt_status_t;
+
+typedef enum {
+    ESP_GAP_BLE_EXT_ADV_SET_RAND_ADDR_COMPLETE_EVT = 24,
+    ESP_GAP_BLE_EXT_ADV_SET_PARAMS_COMPLETE_EVT,
+    ESP_GAP_BLE_EXT_ADV_DATA_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_EXT_SCAN_RSP_DATA_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_EXT_ADV_START_COMPLETE_EVT,
+    ESP_GAP_BLE_EXT_ADV_STOP_COMPLETE_EVT,
+} esp_gap_ble_cb_event_t;
+
+typedef union {
+    struct {
+        esp_bt_status_t status;
+    } ext_adv_data_set;
+} esp_ble_gap_cb_param_t;
+
+typedef void (*gap_event_handler)(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+/*
+  records the data and completes from a separate thread, as Bluedroid
+  does from its own task
+ */
+esp_err_t esp_ble_gap_config_ext_adv_data_raw(uint8_t instance, uint16_t length, const uint8_t *data);
+
+class BLEDevice {
+public:
+    static void init(const char *deviceName);
+    static void setCustomGapHandler(gap_event_handler handler);
+};
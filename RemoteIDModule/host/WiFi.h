@@ -0,0 +1,22 @@
+/*
+  Arduino WiFi class for the Linux host build
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "esp_wifi.h"
+
+class IPAddress {
+public:
+    IPAddress(uint8_t a=0, uint8_t b=0, uint8_t c=0, uint8_t d=0) : addr{a,b,c,d} {}
+private:
+    uint8_t addr[4];
+};
+
+class WiFiClass {
+public:
+    bool softAP(const char *ssid, const char *passphrase=nullptr, int channel=1, int ssid_hidden=0, int max_connection=4);
+    IPAddress softAPIP(void) { return IPAddress(192,168,4,1); }
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,16 @@
+/*
+  ESP-IDF OTA calls for the Linux host build
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+const esp_partition_t *esp_ota_get_running_partition(void);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void);
@@ -0,0 +1,30 @@
+/*
+  ESP-IDF system calls for the Linux host build
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+    ESP_MAC_BT,
+    ESP_MAC_ETH,
+} esp_mac_type_t;
+
+void esp_restart(void);
+esp_err_t esp_base_mac_addr_set(const uint8_t *mac);
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac);
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level);
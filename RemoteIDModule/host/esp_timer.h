@@ -0,0 +1,8 @@
+/*
+  ESP-IDF high resolution timer for the Linux host build
+ */
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
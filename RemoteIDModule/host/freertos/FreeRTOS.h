@@ -0,0 +1,23 @@
+/*
+  FreeRTOS types for the Linux host build
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void *TaskHandle_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY 0xFFFFFFFFU
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (ms)
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+// the host build has threads on any core
+#define CONFIG_FREERTOS_UNICORE 0
+#define ARDUINO_RUNNING_CORE 1
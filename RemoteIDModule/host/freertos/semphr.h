@@ -0,0 +1,13 @@
+/*
+  FreeRTOS semaphores for the Linux host build, only mutexes are
+  supported
+ */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef void *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle);
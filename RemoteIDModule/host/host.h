@@ -0,0 +1,11 @@
+/*
+  controls for the Linux host build
+ */
+#pragma once
+
+// make delay() and delayMicroseconds() return at once, for
+// throughput benchmarks
+void host_set_fast_delays(bool enable);
+
+// enable printing of the debug console to stdout
+void host_set_console(bool enable);
@@ -0,0 +1,556 @@
+/*
+  Arduino and ESP-IDF calls for the Linux host build
+ */
+#include <Arduino.h>
+#include <nvs_flash.h>
+#include <esp_timer.h>
+#include <esp_ota_ops.h>
+#include <freertos/semphr.h>
+#include <chrono>
+#include <thread>
+#include <pthread.h>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <unistd.h>
+#include "host.h"
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+EspClass ESP;
+
+static const auto start_time = std::chrono::steady_clock::now();
+static bool fast_delays;
+
+void host_set_fast_delays(bool enable)
+{
+    fast_delays = enable;
+}
+
+static uint64_t host_micros64(void)
+{
+    const auto dt = std::chrono::steady_clock::now() - start_time;
+    return std::chrono::duration_cast<std::chrono::microseconds>(dt).count();
+}
+
+unsigned long millis(void)
+{
+    return uint32_t(host_micros64() / 1000);
+}
+
+unsigned long micros(void)
+{
+    return uint32_t(host_micros64());
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return host_micros64();
+}
+
+void delay(uint32_t ms)
+{
+    if (fast_delays) {
+        std::this_thread::yield();
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    if (fast_delays) {
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    delay(ticks * portTICK_PERIOD_MS);
+}
+
+void yield(void)
+{
+    std::this_thread::yield();
+}
+
+long random(long howbig)
+{
+    if (howbig <= 0) {
+        return 0;
+    }
+    return ::random() % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+    if (howsmall >= howbig) {
+        return howsmall;
+    }
+    return howsmall + random(howbig - howsmall);
+}
+
+static uint8_t pin_state[GPIO_NUM_MAX];
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    if (pin < GPIO_NUM_MAX) {
+        pin_state[pin] = val;
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < GPIO_NUM_MAX ? pin_state[pin] : LOW;
+}
+
+#if HOST_NEED_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    const size_t len = strlen(src);
+    if (size > 0) {
+        const size_t n = len < size-1 ? len : size-1;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return len;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size)
+{
+    const size_t dlen = strnlen(dst, size);
+    if (dlen == size) {
+        return size + strlen(src);
+    }
+    return dlen + strlcpy(dst + dlen, src, size - dlen);
+}
+#endif
+
+/*
+  String
+ */
+void String::replace(const String &from, const String &to)
+{
+    if (from.str.empty()) {
+        return;
+    }
+    size_t pos = 0;
+    while ((pos = str.find(from.str, pos)) != std::string::npos) {
+        str.replace(pos, from.str.size(), to.str);
+        pos += to.str.size();
+    }
+}
+
+std::string String::fmt_int(long v, unsigned char base)
+{
+    if (v < 0 && base == 10) {
+        return "-" + fmt_uint(-(unsigned long)v, base);
+    }
+    return fmt_uint((unsigned long)v, base);
+}
+
+std::string String::fmt_uint(unsigned long v, unsigned char base)
+{
+    if (base < 2 || base > 36) {
+        base = 10;
+    }
+    std::string s;
+    do {
+        const uint8_t d = v % base;
+        s.insert(s.begin(), char(d < 10 ? '0' + d : 'a' + d - 10));
+        v /= base;
+    } while (v != 0);
+    return s;
+}
+
+std::string String::fmt_float(double v, unsigned int decimals)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", int(decimals), v);
+    return buf;
+}
+
+/*
+  Print and Stream
+ */
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--) {
+        n += write(*buffer++);
+    }
+    return n;
+}
+
+size_t Print::printf(const char *fmt, ...)
+{
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n <= 0) {
+        return 0;
+    }
+    return write((const uint8_t *)buf, strnlen(buf, sizeof(buf)));
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+    size_t n = 0;
+    while (n < length && available() > 0) {
+        buffer[n++] = char(read());
+    }
+    return n;
+}
+
+/*
+  serial ports, the receive queues are shared with the thread driving
+  the simulation so are protected by a mutex
+ */
+static std::mutex serial_mtx;
+static std::deque<uint8_t> serial_rx[2];
+static bool host_console = true;
+
+void host_set_console(bool enable)
+{
+    host_console = enable;
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin)
+{
+}
+
+int HardwareSerial::available()
+{
+    std::lock_guard<std::mutex> lock(serial_mtx);
+    return serial_rx[num].size();
+}
+
+int HardwareSerial::read()
+{
+    std::lock_guard<std::mutex> lock(serial_mtx);
+    if (serial_rx[num].empty()) {
+        return -1;
+    }
+    const uint8_t c = serial_rx[num].front();
+    serial_rx[num].pop_front();
+    return c;
+}
+
+int HardwareSerial::peek()
+{
+    std::lock_guard<std::mutex> lock(serial_mtx);
+    if (serial_rx[num].empty()) {
+        return -1;
+    }
+    return serial_rx[num].front();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    tx_bytes += size;
+    if (num == 0 && host_console) {
+        // Serial is the debug console, but also carries MAVLink on
+        // MAVLINK_COMM_1 so only pass through printable text
+        for (size_t i=0; i<size; i++) {
+            const uint8_t c = buffer[i];
+            if (c == '\n' || (c >= 0x20 && c < 0x7f)) {
+                fputc(c, stdout);
+            }
+        }
+    }
+    return size;
+}
+
+void HardwareSerial::host_inject(const uint8_t *buf, size_t len)
+{
+    std::lock_guard<std::mutex> lock(serial_mtx);
+    serial_rx[num].insert(serial_rx[num].end(), buf, buf+len);
+}
+
+/*
+  ESP
+ */
+uint32_t EspClass::getFreeHeap(void)
+{
+    return 0;
+}
+
+uint32_t EspClass::getCycleCount(void)
+{
+    // emulate a cycle counter at HOST_CPU_MHZ
+    return uint32_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start_time).count() * HOST_CPU_MHZ / 1000);
+}
+
+void EspClass::restart(void)
+{
+    esp_restart();
+}
+
+uint32_t getCpuFrequencyMhz(void)
+{
+    return EspClass::HOST_CPU_MHZ;
+}
+
+void esp_restart(void)
+{
+    printf("esp_restart() called, exiting\n");
+    exit(0);
+}
+
+static const uint8_t host_mac[6] { 0x02, 0x00, 0x00, 0x12, 0x34, 0x56 };
+
+esp_err_t esp_base_mac_addr_set(const uint8_t *mac)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac)
+{
+    memcpy(mac, host_mac, sizeof(host_mac));
+    return ESP_OK;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    memcpy(mac, host_mac, sizeof(host_mac));
+    return ESP_OK;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    default:
+        break;
+    }
+    return "ESP_FAIL";
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    static const esp_partition_t part { 0x10000, 0x1f0000, "app0" };
+    return &part;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    return ESP_OK;
+}
+
+/*
+  FreeRTOS tasks run as detached threads, priority and core are ignored
+ */
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *handle)
+{
+    std::thread t(fn, arg);
+    t.detach();
+    if (handle != nullptr) {
+        *handle = nullptr;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core_id)
+{
+    return xTaskCreate(fn, name, stack_depth, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+    if (handle == nullptr) {
+        pthread_exit(nullptr);
+    }
+}
+
+/*
+  task notification state, one per thread. Tasks never exit in the
+  firmware so these live for the life of the program
+ */
+struct HostTaskNotify {
+    std::mutex mtx;
+    std::condition_variable cv;
+    uint32_t value;
+};
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    thread_local HostTaskNotify *notify = new HostTaskNotify();
+    return (TaskHandle_t)notify;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    auto *n = (HostTaskNotify *)xTaskGetCurrentTaskHandle();
+    if (fast_delays) {
+        std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(n->mtx);
+    if (n->value == 0 && ticks_to_wait > 0 && !fast_delays) {
+        n->cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait * portTICK_PERIOD_MS));
+    }
+    const uint32_t ret = n->value;
+    if (ret > 0) {
+        n->value = clear_on_exit ? 0 : ret - 1;
+    }
+    return ret;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle)
+{
+    auto *n = (HostTaskNotify *)handle;
+    {
+        std::lock_guard<std::mutex> lock(n->mtx);
+        n->value++;
+    }
+    n->cv.notify_one();
+    return pdPASS;
+}
+
+/*
+  mutexes, which live for the life of the program
+ */
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return (SemaphoreHandle_t)new std::timed_mutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks_to_wait)
+{
+    auto *m = (std::timed_mutex *)handle;
+    if (ticks_to_wait == portMAX_DELAY) {
+        m->lock();
+        return pdTRUE;
+    }
+    return m->try_lock_for(std::chrono::milliseconds(ticks_to_wait * portTICK_PERIOD_MS)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle)
+{
+    ((std::timed_mutex *)handle)->unlock();
+    return pdTRUE;
+}
+
+/*
+  NVS, held in memory so every run starts from parameter defaults
+ */
+static std::map<std::string, std::string> nvs_store;
+static std::mutex nvs_mtx;
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    std::lock_guard<std::mutex> lock(nvs_mtx);
+    nvs_store.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+static esp_err_t nvs_get_blob(const char *key, void *out, size_t len)
+{
+    std::lock_guard<std::mutex> lock(nvs_mtx);
+    const auto it = nvs_store.find(key);
+    if (it == nvs_store.end() || it->second.size() != len) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    memcpy(out, it->second.data(), len);
+    return ESP_OK;
+}
+
+static esp_err_t nvs_set_blob(const char *key, const void *v, size_t len)
+{
+    std::lock_guard<std::mutex> lock(nvs_mtx);
+    nvs_store[key] = std::string((const char *)v, len);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    return nvs_get_blob(key, out_value, sizeof(*out_value));
+}
+
+esp_err_t nvs_get_i8(nvs_handle_t handle, const char *key, int8_t *out_value)
+{
+    return nvs_get_blob(key, out_value, sizeof(*out_value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    return nvs_get_blob(key, out_value, sizeof(*out_value));
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    std::lock_guard<std::mutex> lock(nvs_mtx);
+    const auto it = nvs_store.find(std::string("s:") + key);
+    if (it == nvs_store.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (it->second.size() + 1 > *length) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out_value, it->second.c_str(), it->second.size() + 1);
+    *length = it->second.size() + 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return nvs_set_blob(key, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_i8(nvs_handle_t handle, const char *key, int8_t value)
+{
+    return nvs_set_blob(key, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return nvs_set_blob(key, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    std::lock_guard<std::mutex> lock(nvs_mtx);
+    nvs_store[std::string("s:") + key] = value;
+    return ESP_OK;
+}
@@ -0,0 +1,330 @@
+/*
+  Linux host driver for the firmware logic
+
+  feeds OpenDroneID MAVLink messages into the MAVLink serial port,
+  runs the firmware setup() and loop() and reports what the radios
+  would have transmitted. Two modes:
+
+   - simulation (default): real time run at the configured rates
+   - benchmark (-b N): delays return at once and N location updates
+     are pushed through the ingest path as fast as possible
+ */
+#include <Arduino.h>
+#include <unistd.h>
+#include <chrono>
+#include "host.h"
+#include "host_radio.h"
+#include "../mavlink_msgs.h"
+#include <opendroneid.h>
+#include "../parameters.h"
+#include "../profile.h"
+#include "../status.h"
+#include "../util.h"
+
+void setup(void);
+void loop(void);
+
+// system and component IDs of the simulated flight controller
+#define FC_SYSID 1
+#define FC_COMPID 1
+
+// simulated UTC at startup, on the hour so the location timestamps
+// (seconds after the hour) are millis() based
+#define FC_UTC_START_US 1700002800000000ULL
+
+static void send_msg(const mavlink_message_t &msg)
+{
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t len = mavlink_msg_to_send_buffer(buf, &msg);
+    Serial1.host_inject(buf, len);
+}
+
+static void send_heartbeat(void)
+{
+    mavlink_heartbeat_t hb {};
+    hb.type = MAV_TYPE_QUADROTOR;
+    hb.autopilot = MAV_AUTOPILOT_ARDUPILOTMEGA;
+    mavlink_message_t msg;
+    mavlink_msg_heartbeat_encode(FC_SYSID, FC_COMPID, &msg, &hb);
+    send_msg(msg);
+}
+
+static void send_system_time(void)
+{
+    mavlink_system_time_t st {};
+    st.time_unix_usec = FC_UTC_START_US + uint64_t(millis()) * 1000U;
+    st.time_boot_ms = millis();
+    mavlink_message_t msg;
+    mavlink_msg_system_time_encode(FC_SYSID, FC_COMPID, &msg, &st);
+    send_msg(msg);
+}
+
+/*
+  the messages which only change occasionally
+ */
+static void send_static_messages(void)
+{
+    mavlink_message_t msg;
+
+    mavlink_open_drone_id_basic_id_t basic_id {};
+    basic_id.id_type = MAV_ODID_ID_TYPE_SERIAL_NUMBER;
+    basic_id.ua_type = MAV_ODID_UA_TYPE_HELICOPTER_OR_MULTIROTOR;
+    strncpy((char *)basic_id.uas_id, "HOST1234567890", sizeof(basic_id.uas_id));
+    mavlink_msg_open_drone_id_basic_id_encode(FC_SYSID, FC_COMPID, &msg, &basic_id);
+    send_msg(msg);
+
+    mavlink_open_drone_id_system_t system {};
+    system.operator_location_type = MAV_ODID_OPERATOR_LOCATION_TYPE_TAKEOFF;
+    system.classification_type = MAV_ODID_CLASSIFICATION_TYPE_EU;
+    system.operator_latitude = -353632610;
+    system.operator_longitude = 1491652370;
+    system.area_count = 1;
+    system.area_radius = 0;
+    system.area_ceiling = -1000;
+    system.area_floor = -1000;
+    system.category_eu = MAV_ODID_CATEGORY_EU_OPEN;
+    system.class_eu = MAV_ODID_CLASS_EU_CLASS_1;
+    system.operator_altitude_geo = 584;
+    system.timestamp = millis() / 1000;
+    mavlink_msg_open_drone_id_system_encode(FC_SYSID, FC_COMPID, &msg, &system);
+    send_msg(msg);
+
+    mavlink_open_drone_id_operator_id_t operator_id {};
+    operator_id.operator_id_type = MAV_ODID_OPERATOR_ID_TYPE_CAA;
+    strncpy(operator_id.operator_id, "FIN87astrdge12k8", sizeof(operator_id.operator_id));
+    mavlink_msg_open_drone_id_operator_id_encode(FC_SYSID, FC_COMPID, &msg, &operator_id);
+    send_msg(msg);
+
+    mavlink_open_drone_id_self_id_t self_id {};
+    self_id.description_type = MAV_ODID_DESC_TYPE_TEXT;
+    strncpy(self_id.description, "host simulation", sizeof(self_id.description));
+    mavlink_msg_open_drone_id_self_id_encode(FC_SYSID, FC_COMPID, &msg, &self_id);
+    send_msg(msg);
+}
+
+/*
+  an authentication sequence of num_pages pages
+ */
+static void send_authentication(uint8_t num_pages)
+{
+    mavlink_message_t msg;
+    for (uint8_t i=0; i<num_pages; i++) {
+        mavlink_open_drone_id_authentication_t auth {};
+        auth.authentication_type = 1;
+        auth.data_page = i;
+        auth.last_page_index = num_pages-1;
+        auth.length = 17 + 23*(num_pages-1);
+        auth.timestamp = i == 0 ? 1000 : 0;
+        memset(auth.authentication_data, 0xA0+i, sizeof(auth.authentication_data));
+        mavlink_msg_open_drone_id_authentication_encode(FC_SYSID, FC_COMPID, &msg, &auth);
+        send_msg(msg);
+    }
+}
+
+/*
+  a location moving around a circle, so every update encodes differently
+ */
+static void send_location(uint32_t seq, bool emergency)
+{
+    const float t = seq * 0.01;
+    mavlink_open_drone_id_location_t loc {};
+    loc.status = emergency ? MAV_ODID_STATUS_EMERGENCY : MAV_ODID_STATUS_AIRBORNE;
+    loc.direction = uint16_t(fmodf(t * 57.3, 360) * 100);
+    loc.speed_horizontal = 500;
+    loc.speed_vertical = 0;
+    loc.latitude = -353632610 + int32_t(1000 * sinf(t));
+    loc.longitude = 1491652370 + int32_t(1000 * cosf(t));
+    loc.altitude_barometric = 600;
+    loc.altitude_geodetic = 610;
+    loc.height_reference = MAV_ODID_HEIGHT_REF_OVER_TAKEOFF;
+    loc.height = 26;
+    loc.horizontal_accuracy = MAV_ODID_HOR_ACC_3_METER;
+    loc.vertical_accuracy = MAV_ODID_VER_ACC_3_METER;
+    loc.barometer_accuracy = MAV_ODID_VER_ACC_3_METER;
+    loc.speed_accuracy = MAV_ODID_SPEED_ACC_1_METERS_PER_SECOND;
+    loc.timestamp = fmodf(millis() * 0.001, 3600);
+    loc.timestamp_accuracy = MAV_ODID_TIME_ACC_0_1_SECOND;
+    mavlink_message_t msg;
+    mavlink_msg_open_drone_id_location_encode(FC_SYSID, FC_COMPID, &msg, &loc);
+    send_msg(msg);
+}
+
+static bool set_param(const char *name, float value)
+{
+    const auto *p = Parameters::find(name);
+    if (p == nullptr) {
+        printf("Unknown parameter %s\n", name);
+        return false;
+    }
+    p->set_as_float(value);
+    return true;
+}
+
+static void print_hex(const uint8_t *data, uint16_t len)
+{
+    for (uint16_t i=0; i<len; i++) {
+        printf("%02x%s", data[i], (i % 32 == 31 || i == len-1) ? "\n" : " ");
+    }
+}
+
+static void report(float elapsed_s, bool verbose)
+{
+    printf("\nRadio output over %.1f s\n", elapsed_s);
+    printf("%-20s %10s %10s %12s\n", "type", "count", "rate Hz", "bytes");
+    for (uint8_t i=0; i<uint8_t(HostRadio::Type::NUM_TYPES); i++) {
+        const auto type = HostRadio::Type(i);
+        const auto s = host_radio.get_stats(type);
+        if (s.count == 0) {
+            continue;
+        }
+        printf("%-20s %10llu %10.2f %12llu\n", HostRadio::type_name(type),
+               (unsigned long long)s.count, s.count / elapsed_s,
+               (unsigned long long)s.bytes);
+        HostRadio::Frame f;
+        if (verbose && host_radio.get_last(type, f)) {
+            print_hex(f.data, f.len);
+        }
+    }
+    printf("MAVLink bytes sent: %llu\n", (unsigned long long)Serial1.host_tx_bytes());
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("  -t SECONDS    simulation time (default 10)\n");
+    printf("  -r HZ         location update rate (default 10)\n");
+    printf("  -b N          benchmark N location updates, no delays\n");
+    printf("  -p NAME=VALUE set a parameter, may be repeated\n");
+    printf("  -e SECONDS    declare an emergency after SECONDS\n");
+    printf("  -a PAGES      send an authentication sequence of PAGES pages\n");
+    printf("  -j            print status and profiler JSON\n");
+    printf("  -v            print the last frame of each type\n");
+    printf("  -q            don't print the debug console\n");
+}
+
+int main(int argc, char **argv)
+{
+    float duration_s = 10;
+    float location_hz = 10;
+    float emergency_s = -1;
+    uint32_t bench_count = 0;
+    uint8_t auth_pages = 0;
+    bool json = false;
+    bool verbose = false;
+    bool quiet = false;
+    const char *params[32];
+    uint8_t num_params = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:r:b:p:e:a:jvqh")) != -1) {
+        switch (opt) {
+        case 't':
+            duration_s = atof(optarg);
+            break;
+        case 'r':
+            location_hz = atof(optarg);
+            break;
+        case 'b':
+            bench_count = strtoul(optarg, nullptr, 0);
+            break;
+        case 'p':
+            if (num_params < ARRAY_SIZE(params)) {
+                params[num_params++] = optarg;
+            }
+            break;
+        case 'e':
+            emergency_s = atof(optarg);
+            break;
+        case 'a':
+            auth_pages = constrain(atoi(optarg), 0, ODID_AUTH_MAX_PAGES);
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    host_set_console(!quiet);
+
+    setup();
+
+    // profile everything on the host
+    set_param("OPTIONS", g.options | OPTIONS_PROFILE);
+    for (uint8_t i=0; i<num_params; i++) {
+        char name[PARAM_NAME_MAX_LEN+1] {};
+        const char *eq = strchr(params[i], '=');
+        if (eq == nullptr || eq - params[i] > PARAM_NAME_MAX_LEN) {
+            printf("Bad parameter %s\n", params[i]);
+            return 1;
+        }
+        memcpy(name, params[i], eq - params[i]);
+        if (!set_param(name, atof(eq+1))) {
+            return 1;
+        }
+    }
+
+    send_heartbeat();
+    send_static_messages();
+    send_authentication(auth_pages);
+
+    const auto start = std::chrono::steady_clock::now();
+    float elapsed_s = 0;
+
+    if (bench_count > 0) {
+        host_set_fast_delays(true);
+        // get the static messages processed before we start timing
+        loop();
+        profiler.reset();
+        const auto t0 = std::chrono::steady_clock::now();
+        for (uint32_t i=0; i<bench_count; i++) {
+            send_location(i, false);
+            loop();
+        }
+        const auto dt = std::chrono::steady_clock::now() - t0;
+        const double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count();
+        printf("\n%u location updates in %.3f ms, %.0f ns per update, %.0f updates/s\n",
+               unsigned(bench_count), ns * 1.0e-6, ns / bench_count, bench_count * 1.0e9 / ns);
+        elapsed_s = ns * 1.0e-9;
+    } else {
+        uint32_t seq = 0;
+        uint32_t last_static_ms = millis();
+        uint32_t next_location_us = micros();
+        const uint32_t location_period_us = 1.0e6 / location_hz;
+        while (elapsed_s < duration_s) {
+            const uint32_t now_us = micros();
+            if (int32_t(now_us - next_location_us) >= 0) {
+                next_location_us += location_period_us;
+                send_location(seq++, emergency_s >= 0 && elapsed_s >= emergency_s);
+            }
+            if (millis() - last_static_ms >= 1000) {
+                last_static_ms = millis();
+                send_heartbeat();
+                send_system_time();
+                send_static_messages();
+            }
+            loop();
+            elapsed_s = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count() * 1.0e-6;
+        }
+    }
+
+    report(elapsed_s, verbose);
+
+    if (json) {
+        printf("\nstatus: %s\n", status_json().c_str());
+        printf("\nprofile: %s\n", profile_json().c_str());
+    }
+
+    // the radio task never exits, so don't wait for it
+    fflush(stdout);
+    _exit(0);
+}
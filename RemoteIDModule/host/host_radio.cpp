@@ -0,0 +1,289 @@
+/*
+  radio calls for the Linux host build
+
+  everything the firmware would put on air is recorded in memory so
+  it can be counted, timed and checked
+ */
+#include <Arduino.h>
+#include <esp_wifi.h>
+#include <WiFi.h>
+#include <BLEDevice.h>
+#include <BLEAdvertising.h>
+#include "host_radio.h"
+#include <thread>
+#include <condition_variable>
+#include <deque>
+
+HostRadio host_radio;
+WiFiClass WiFi;
+
+static HostRadio::Frame *frame_init(HostRadio::Frame &f, HostRadio::Type type, const void *data, size_t len)
+{
+    f.type = type;
+    f.time_us = micros();
+    f.len = len < HostRadio::MAX_FRAME ? len : HostRadio::MAX_FRAME;
+    memcpy(f.data, data, f.len);
+    return &f;
+}
+
+void HostRadio::record(Type type, const void *data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    const uint8_t t = uint8_t(type);
+    auto &s = stats[t];
+    const uint32_t now_us = micros();
+    if (s.count == 0) {
+        s.first_us = now_us;
+    }
+    s.last_us = now_us;
+    s.count++;
+    s.bytes += len;
+    frame_init(last[t], type, data, len);
+
+    if (ring_len == RING_SIZE) {
+        // overwrite the oldest frame
+        ring_head = (ring_head + 1) % RING_SIZE;
+        ring_len--;
+        dropped++;
+    }
+    frame_init(ring[(ring_head + ring_len) % RING_SIZE], type, data, len);
+    ring_len++;
+}
+
+HostRadio::Stats HostRadio::get_stats(Type type)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return stats[uint8_t(type)];
+}
+
+bool HostRadio::get_last(Type type, Frame &frame)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (stats[uint8_t(type)].count == 0) {
+        return false;
+    }
+    frame = last[uint8_t(type)];
+    return true;
+}
+
+bool HostRadio::pop(Frame &frame)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (ring_len == 0) {
+        return false;
+    }
+    frame = ring[ring_head];
+    ring_head = (ring_head + 1) % RING_SIZE;
+    ring_len--;
+    return true;
+}
+
+uint64_t HostRadio::get_dropped(void)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return dropped;
+}
+
+void HostRadio::reset(void)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    memset(stats, 0, sizeof(stats));
+    ring_head = 0;
+    ring_len = 0;
+    dropped = 0;
+}
+
+const char *HostRadio::type_name(Type type)
+{
+    switch (type) {
+    case Type::WIFI_TX:
+        return "WIFI_TX";
+    case Type::WIFI_BEACON_IE:
+        return "WIFI_BEACON_IE";
+    case Type::WIFI_PROBE_RESP_IE:
+        return "WIFI_PROBE_RESP_IE";
+    case Type::BLE_ADV_0:
+        return "BLE_ADV_0";
+    case Type::BLE_ADV_1:
+        return "BLE_ADV_1";
+    case Type::BLE_ADV_2:
+        return "BLE_ADV_2";
+    case Type::BLE_ADV_3:
+        return "BLE_ADV_3";
+    case Type::BLE_ADV_4:
+        return "BLE_ADV_4";
+    case Type::BLE_ADV_5:
+        return "BLE_ADV_5";
+    case Type::BLE_ADV_6:
+        return "BLE_ADV_6";
+    case Type::BLE_ADV_7:
+        return "BLE_ADV_7";
+    case Type::BLE_ADV_8:
+        return "BLE_ADV_8";
+    case Type::BLE_ADV_9:
+        return "BLE_ADV_9";
+    default:
+        break;
+    }
+    return "UNKNOWN";
+}
+
+/*
+  WiFi
+ */
+bool WiFiClass::softAP(const char *ssid, const char *passphrase, int channel, int ssid_hidden, int max_connection)
+{
+    return true;
+}
+
+esp_err_t esp_wifi_set_bandwidth(wifi_interface_t ifx, wifi_bandwidth_t bw)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_max_tx_power(int8_t power)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_80211_tx(wifi_interface_t ifx, const void *buffer, int len, bool en_sys_seq)
+{
+    if (len <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_radio.record(HostRadio::Type::WIFI_TX, buffer, len);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_vendor_ie(bool enable, wifi_vendor_ie_type_t type, wifi_vendor_ie_id_t idx, const void *vnd_ie)
+{
+    if (!enable) {
+        return ESP_OK;
+    }
+    const auto *ie = (const vendor_ie_data_t *)vnd_ie;
+    // element id and length header plus the element body
+    const size_t len = 2 + ie->length;
+    switch (type) {
+    case WIFI_VND_IE_TYPE_BEACON:
+        host_radio.record(HostRadio::Type::WIFI_BEACON_IE, vnd_ie, len);
+        break;
+    case WIFI_VND_IE_TYPE_PROBE_RESP:
+        host_radio.record(HostRadio::Type::WIFI_PROBE_RESP_IE, vnd_ie, len);
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+/*
+  BLE
+ */
+void BLEDevice::init(const char *deviceName)
+{
+}
+
+static gap_event_handler custom_gap_handler;
+
+void BLEDevice::setCustomGapHandler(gap_event_handler handler)
+{
+    custom_gap_handler = handler;
+}
+
+/*
+  GAP completion events, delivered in order by one thread like the
+  Bluedroid task
+ */
+static std::mutex gap_mtx;
+static std::condition_variable gap_cv;
+static std::deque<esp_gap_ble_cb_event_t> gap_events;
+
+static void gap_thread(void)
+{
+    while (true) {
+        esp_gap_ble_cb_event_t event;
+        {
+            std::unique_lock<std::mutex> lock(gap_mtx);
+            gap_cv.wait(lock, []{ return !gap_events.empty(); });
+            event = gap_events.front();
+            gap_events.pop_front();
+        }
+        esp_ble_gap_cb_param_t param {};
+        param.ext_adv_data_set.status = ESP_BT_STATUS_SUCCESS;
+        if (custom_gap_handler != nullptr) {
+            custom_gap_handler(event, &param);
+        }
+    }
+}
+
+esp_err_t esp_ble_gap_config_ext_adv_data_raw(uint8_t instance, uint16_t length, const uint8_t *data)
+{
+    if (instance > uint8_t(HostRadio::Type::BLE_ADV_9) - uint8_t(HostRadio::Type::BLE_ADV_0)) {
+        return ESP_FAIL;
+    }
+    host_radio.record(HostRadio::Type(uint8_t(HostRadio::Type::BLE_ADV_0) + instance), data, length);
+
+    static std::once_flag started;
+    std::call_once(started, []{ std::thread(gap_thread).detach(); });
+    {
+        std::lock_guard<std::mutex> lock(gap_mtx);
+        gap_events.push_back(ESP_GAP_BLE_EXT_ADV_DATA_SET_COMPLETE_EVT);
+    }
+    gap_cv.notify_one();
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_prefered_default_phy(esp_ble_gap_prefer_phy_options_t tx_phy_mask,
+                                               esp_ble_gap_prefer_phy_options_t rx_phy_mask)
+{
+    return ESP_OK;
+}
+
+BLEMultiAdvertising::BLEMultiAdvertising(uint8_t num) :
+    count(num)
+{
+}
+
+bool BLEMultiAdvertising::setAdvertisingData(uint8_t instance, uint16_t length, const uint8_t *data)
+{
+    if (instance >= count || instance > uint8_t(HostRadio::Type::BLE_ADV_9) - uint8_t(HostRadio::Type::BLE_ADV_0)) {
+        return false;
+    }
+    host_radio.record(HostRadio::Type(uint8_t(HostRadio::Type::BLE_ADV_0) + instance), data, length);
+    return true;
+}
+
+bool BLEMultiAdvertising::setAdvertisingParams(uint8_t instance, const esp_ble_gap_ext_adv_params_t *params)
+{
+    return instance < count;
+}
+
+bool BLEMultiAdvertising::setInstanceAddress(uint8_t instance, uint8_t *rand_addr)
+{
+    return instance < count;
+}
+
+bool BLEMultiAdvertising::setDuration(uint8_t instance, int duration, int max_events)
+{
+    return instance < count;
+}
+
+bool BLEMultiAdvertising::start(void)
+{
+    return start(count, 0);
+}
+
+bool BLEMultiAdvertising::start(uint8_t num, uint8_t from)
+{
+    return from + num <= count;
+}
+
+bool BLEMultiAdvertising::stop(uint8_t num_adv, const uint8_t *ext_adv_inst)
+{
+    for (uint8_t i=0; i<num_adv; i++) {
+        if (ext_adv_inst[i] >= count) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+/*
+  capture of radio output for the Linux host build
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+
+class HostRadio {
+public:
+    enum class Type : uint8_t {
+        WIFI_TX=0,          // raw 802.11 frames from esp_wifi_80211_tx
+        WIFI_BEACON_IE,     // vendor IE set for beacons
+        WIFI_PROBE_RESP_IE, // vendor IE set for probe responses
+        BLE_ADV_0,          // advertising data per BLE instance
+        BLE_ADV_1,
+        BLE_ADV_2,
+        BLE_ADV_3,
+        BLE_ADV_4,
+        BLE_ADV_5,
+        BLE_ADV_6,
+        BLE_ADV_7,
+        BLE_ADV_8,
+        BLE_ADV_9,
+        NUM_TYPES
+    };
+
+    static const uint16_t MAX_FRAME = 512;
+    static const uint16_t RING_SIZE = 256;
+
+    struct Frame {
+        Type type;
+        uint32_t time_us;
+        uint16_t len;
+        uint8_t data[MAX_FRAME];
+    };
+
+    struct Stats {
+        uint64_t count;
+        uint64_t bytes;
+        uint32_t first_us;
+        uint32_t last_us;
+    };
+
+    void record(Type type, const void *data, size_t len);
+
+    Stats get_stats(Type type);
+
+    // copy of the most recent frame of a type, false if none
+    bool get_last(Type type, Frame &frame);
+
+    // take the oldest frame from the capture ring, false if empty
+    bool pop(Frame &frame);
+
+    // frames lost because the ring was full
+    uint64_t get_dropped(void);
+
+    void reset(void);
+
+    static const char *type_name(Type type);
+
+private:
+    std::mutex mtx;
+    Stats stats[uint8_t(Type::NUM_TYPES)];
+    Frame last[uint8_t(Type::NUM_TYPES)];
+    Frame ring[RING_SIZE];
+    uint16_t ring_head;
+    uint16_t ring_len;
+    uint64_t dropped;
+};
+
+extern HostRadio host_radio;
@@ -0,0 +1,30 @@
+/*
+  parts of the firmware which only make sense on hardware, replaced
+  with no-ops for the Linux host build
+ */
+#include <Arduino.h>
+#include "../webinterface.h"
+#include "../check_firmware.h"
+#include "../efuse.h"
+
+void WebInterface::init(void)
+{
+}
+
+void WebInterface::update(void)
+{
+}
+
+bool CheckFirmware::check_OTA_running(void)
+{
+    return true;
+}
+
+bool CheckFirmware::check_OTA_next(const esp_partition_t *part, const uint8_t *lead_bytes, uint32_t lead_length)
+{
+    return false;
+}
+
+void set_efuses(void)
+{
+}
@@ -0,0 +1,6 @@
+/*
+  RTC control registers for the Linux host build
+ */
+#pragma once
+
+#define RTC_CNTL_BROWN_OUT_REG 0
@@ -0,0 +1,82 @@
+/*
+  location latency
+
+  the age of each transmitted location is measured against UTC from
+  the time synchronisation with the flight controller. The Location
+  timestamp has 0.1s resolution, so this is only an upper bound to
+  within that
+ */
+#include <Arduino.h>
+#include "latency.h"
+#include "timesync.h"
+#include "util.h"
+#include <esp_timer.h>
+#include <math.h>
+
+TxLatency tx_latency;
+
+// ages above this are a bad timestamp or time sync, not latency
+#define LATENCY_MAX_MS 60000
+
+void TxLatency::sent(TxScheduler::Job job, float location_timestamp)
+{
+    const uint8_t idx = uint8_t(job);
+    if (idx >= uint8_t(TxScheduler::Job::NUM_JOBS) ||
+        location_timestamp < 0 || location_timestamp > 3600) {
+        return;
+    }
+    uint64_t utc_us;
+    if (!timesync.get_utc_us(esp_timer_get_time(), utc_us)) {
+        return;
+    }
+    // both in seconds after the hour
+    const uint32_t now_ms = (utc_us / 1000U) % 3600000U;
+    const uint32_t ts_ms = uint32_t(location_timestamp * 1000);
+    int32_t age_ms = int32_t(now_ms) - int32_t(ts_ms);
+    if (age_ms < -1800000) {
+        age_ms += 3600000;
+    } else if (age_ms > 1800000) {
+        age_ms -= 3600000;
+    }
+    if (age_ms > LATENCY_MAX_MS) {
+        return;
+    }
+    if (age_ms < 0) {
+        // the timestamp may be a little ahead of our clock
+        age_ms = 0;
+    }
+
+    auto &j = jobs[idx];
+    j.samples_ms[j.count % NUM_SAMPLES] = age_ms;
+    j.count++;
+}
+
+void TxLatency::get_stats(TxScheduler::Job job, Stats &stats) const
+{
+    memset(&stats, 0, sizeof(stats));
+    const uint8_t idx = uint8_t(job);
+    if (idx >= uint8_t(TxScheduler::Job::NUM_JOBS)) {
+        return;
+    }
+    const auto &j = jobs[idx];
+    stats.count = j.count;
+    const uint8_t n = MIN(j.count, uint32_t(NUM_SAMPLES));
+    if (n == 0) {
+        return;
+    }
+
+    // insertion sort a copy, the radio task may be adding samples
+    uint16_t sorted[NUM_SAMPLES];
+    for (uint8_t i=0; i<n; i++) {
+        const uint16_t v = j.samples_ms[i];
+        uint8_t k = i;
+        while (k > 0 && sorted[k-1] > v) {
+            sorted[k] = sorted[k-1];
+            k--;
+        }
+        sorted[k] = v;
+    }
+    stats.p50_ms = sorted[(n-1) / 2];
+    stats.p95_ms = sorted[((n-1) * 95) / 100];
+    stats.max_ms = sorted[n-1];
+}
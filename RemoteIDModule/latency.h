@@ -0,0 +1,36 @@
+/*
+  latency from the flight controller location timestamp to the frame
+  carrying it being sent, per radio
+ */
+#pragma once
+
+#include <stdint.h>
+#include "scheduler.h"
+
+class TxLatency {
+public:
+    /*
+      a frame carrying a location with the given ODID timestamp, in
+      seconds after the hour, was sent by a job
+     */
+    void sent(TxScheduler::Job job, float location_timestamp);
+
+    struct Stats {
+        uint32_t count;
+        uint16_t p50_ms;
+        uint16_t p95_ms;
+        uint16_t max_ms;
+    };
+
+    // percentiles over the last NUM_SAMPLES frames of a job
+    void get_stats(TxScheduler::Job job, Stats &stats) const;
+
+private:
+    static const uint8_t NUM_SAMPLES = 64;
+    struct {
+        uint16_t samples_ms[NUM_SAMPLES];
+        uint32_t count;
+    } jobs[uint8_t(TxScheduler::Job::NUM_JOBS)];
+};
+
+extern TxLatency tx_latency;
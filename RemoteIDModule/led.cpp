@@ -23,7 +23,9 @@ void Led::update(void)
 {
     init();
 
+#if defined(PIN_STATUS_LED) || defined(WS2812_LED_PIN)
     const uint32_t now_ms = millis();
+#endif
 
 #ifdef PIN_STATUS_LED
     switch (state) {
@@ -0,0 +1,115 @@
+/*
+  weighted scheduling of the BT4 legacy advertising frames
+
+  legacy advertising carries one message per frame, so the messages
+  share the BT4 airtime. The frames are picked by smooth weighted round
+  robin with the BT4_W_* weights, which gives the dynamic Location a
+  bigger share than the static messages without raising the total
+  advertising rate. Weights spread each frame's turns evenly through
+  the cycle rather than sending them back to back.
+
+  BT4_STATIC_MAX is the longest we let a static message go unsent,
+  which holds even with a weight of zero
+ */
+#include <Arduino.h>
+#include "legacy_sched.h"
+#include "parameters.h"
+
+LegacyScheduler legacy_sched;
+
+// window for the achieved rate statistics
+#define LEGACY_RATE_WINDOW_MS 5000
+
+uint8_t LegacyScheduler::weight(uint8_t frame)
+{
+    switch (frame) {
+    case uint8_t(ODIDCache::Msg::BASIC_ID_1):
+    case uint8_t(ODIDCache::Msg::BASIC_ID_2):
+        return g.bt4_w_basicid;
+    case uint8_t(ODIDCache::Msg::LOCATION):
+        return g.bt4_w_loc;
+    case uint8_t(ODIDCache::Msg::SELF_ID):
+        return g.bt4_w_selfid;
+    case uint8_t(ODIDCache::Msg::SYSTEM):
+        return g.bt4_w_system;
+    case uint8_t(ODIDCache::Msg::OPERATOR_ID):
+        return g.bt4_w_opid;
+    case NAME_FRAME:
+        return g.bt4_w_name;
+    default:
+        break;
+    }
+    return 0;
+}
+
+/*
+  the static message that has gone longest without being sent, if it
+  is past BT4_STATIC_MAX, otherwise NUM_FRAMES
+ */
+uint8_t LegacyScheduler::overdue_static(uint8_t available_mask, uint32_t now_ms) const
+{
+    if (g.bt4_static_max <= 0) {
+        return NUM_FRAMES;
+    }
+    const uint32_t max_ms = g.bt4_static_max * 1000;
+    uint8_t ret = NUM_FRAMES;
+    uint32_t oldest_ms = 0;
+    for (uint8_t i=0; i<NAME_FRAME; i++) {
+        if (i == uint8_t(ODIDCache::Msg::LOCATION) || (available_mask & (1U<<i)) == 0) {
+            continue;
+        }
+        const uint32_t age_ms = now_ms - last_sent_ms[i];
+        if (age_ms >= max_ms && age_ms >= oldest_ms) {
+            oldest_ms = age_ms;
+            ret = i;
+        }
+    }
+    return ret;
+}
+
+uint8_t LegacyScheduler::next(uint8_t available_mask, uint32_t now_ms)
+{
+    uint8_t frame = overdue_static(available_mask, now_ms);
+    if (frame != NUM_FRAMES) {
+        stats.refreshes++;
+        sent(frame, now_ms);
+        return frame;
+    }
+
+    int16_t total = 0;
+    for (uint8_t i=0; i<NUM_FRAMES; i++) {
+        if ((available_mask & (1U<<i)) == 0) {
+            credit[i] = 0;
+            continue;
+        }
+        const uint8_t w = weight(i);
+        credit[i] += w;
+        total += w;
+        if (w > 0 && (frame == NUM_FRAMES || credit[i] > credit[frame])) {
+            frame = i;
+        }
+    }
+    if (frame == NUM_FRAMES) {
+        // all the weights are zero, fall back to the Location
+        frame = (available_mask & (1U<<uint8_t(ODIDCache::Msg::LOCATION))) ? uint8_t(ODIDCache::Msg::LOCATION) : NAME_FRAME;
+    } else {
+        credit[frame] -= total;
+    }
+    sent(frame, now_ms);
+    return frame;
+}
+
+void LegacyScheduler::sent(uint8_t frame, uint32_t now_ms)
+{
+    last_sent_ms[frame] = now_ms;
+    window_count[frame]++;
+
+    const uint32_t dt_ms = now_ms - window_start_ms;
+    if (dt_ms >= LEGACY_RATE_WINDOW_MS) {
+        for (uint8_t i=0; i<NUM_FRAMES; i++) {
+            stats.rate_hz[i] = window_count[i] * 1000.0 / dt_ms;
+            window_count[i] = 0;
+        }
+        window_start_ms = now_ms;
+    }
+}
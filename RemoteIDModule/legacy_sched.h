@@ -0,0 +1,45 @@
+/*
+  weighted scheduling of the BT4 legacy advertising frames
+ */
+#pragma once
+
+#include <stdint.h>
+#include "odid_cache.h"
+
+class LegacyScheduler {
+public:
+    // frames are indexed by ODIDCache::Msg, then the BLE name frame
+    static const uint8_t NAME_FRAME = uint8_t(ODIDCache::Msg::NUM_MSGS);
+    static const uint8_t NUM_FRAMES = NAME_FRAME+1;
+
+    /*
+      pick the frame for the next legacy transmit from the frames in
+      available_mask, and count it as sent
+     */
+    uint8_t next(uint8_t available_mask, uint32_t now_ms);
+
+    struct Stats {
+        // achieved transmit rate of each frame over the last window
+        float rate_hz[NUM_FRAMES];
+        // static messages sent early to meet BT4_STATIC_MAX
+        uint32_t refreshes;
+    };
+
+    const Stats &get_stats(void) const {
+        return stats;
+    }
+
+private:
+    // smooth weighted round robin credit of each frame
+    int16_t credit[NUM_FRAMES];
+    uint32_t last_sent_ms[NUM_FRAMES];
+    uint16_t window_count[NUM_FRAMES];
+    uint32_t window_start_ms;
+    Stats stats;
+
+    static uint8_t weight(uint8_t frame);
+    uint8_t overdue_static(uint8_t available_mask, uint32_t now_ms) const;
+    void sent(uint8_t frame, uint32_t now_ms);
+};
+
+extern LegacyScheduler legacy_sched;
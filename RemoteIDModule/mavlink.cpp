@@ -6,9 +6,16 @@
 #include "board_config.h"
 #include "version.h"
 #include "parameters.h"
+#include "profile.h"
+#include "timesync.h"
+#include <esp_timer.h>
 
 #define SERIAL_BAUD 115200
 
+// interval of our TIMESYNC requests, and of SYSTEM_TIME requests while
+// the flight controller is not sending it
+#define TIMESYNC_INTERVAL_MS 5000
+
 static HardwareSerial *serial_ports[MAVLINK_COMM_NUM_BUFFERS];
 
 #include <generated/mavlink_helpers.h>
@@ -93,6 +100,16 @@ void MAVLinkSerial::update_send(void)
         // send arming status
         arm_status_send();
     }
+    if (now_ms - last_timesync_ms >= TIMESYNC_INTERVAL_MS) {
+        last_timesync_ms = now_ms;
+        timesync_send();
+    }
+#if AP_PROFILE_ENABLED
+    if (Profiler::enabled() && now_ms - last_profile_ms >= 250) {
+        last_profile_ms = now_ms;
+        profile_send();
+    }
+#endif
 }
 
 void MAVLinkSerial::update_receive(void)
@@ -144,6 +161,7 @@ void MAVLinkSerial::process_packet(mavlink_status_t &status, mavlink_message_t &
     }
     case MAVLINK_MSG_ID_OPEN_DRONE_ID_LOCATION: {
         mavlink_msg_open_drone_id_location_decode(&msg, &location);
+        generation.location++;
         if (g.options & OPTIONS_PRINT_RID_MAVLINK) {
             Serial.printf("MAVLink: got Location\n");
         }
@@ -153,6 +171,7 @@ void MAVLinkSerial::process_packet(mavlink_status_t &status, mavlink_message_t &
             last_location_timestamp = location.timestamp;
         }
         last_location_ms = now_ms;
+        update_emergency();
         break;
     }
     case MAVLINK_MSG_ID_OPEN_DRONE_ID_BASIC_ID: {
@@ -164,27 +183,37 @@ void MAVLinkSerial::process_packet(mavlink_status_t &status, mavlink_message_t &
         if ((strlen((const char*) basic_id_tmp.uas_id) > 0) && (basic_id_tmp.id_type > 0) && (basic_id_tmp.id_type <= MAV_ODID_ID_TYPE_SPECIFIC_SESSION_ID)) {
             //only update if we receive valid data
             basic_id = basic_id_tmp;
+            generation.basic_id++;
             last_basic_id_ms = now_ms;
         }
         break;
     }
     case MAVLINK_MSG_ID_OPEN_DRONE_ID_AUTHENTICATION: {
-        mavlink_msg_open_drone_id_authentication_decode(&msg, &authentication);
+        mavlink_open_drone_id_authentication_t auth;
+        mavlink_msg_open_drone_id_authentication_decode(&msg, &auth);
+        if (auth.data_page >= ODID_AUTH_MAX_PAGES) {
+            break;
+        }
+        authentication[auth.data_page] = auth;
+        generation.authentication++;
         if (g.options & OPTIONS_PRINT_RID_MAVLINK) {
-            Serial.printf("MAVLink: got Auth\n");
+            Serial.printf("MAVLink: got Auth page %u\n", unsigned(auth.data_page));
         }
         break;
     }
     case MAVLINK_MSG_ID_OPEN_DRONE_ID_SELF_ID: {
         mavlink_msg_open_drone_id_self_id_decode(&msg, &self_id);
+        generation.self_id++;
         if (g.options & OPTIONS_PRINT_RID_MAVLINK) {
             Serial.printf("MAVLink: got SelfID\n");
         }
         last_self_id_ms = now_ms;
+        update_emergency();
         break;
     }
     case MAVLINK_MSG_ID_OPEN_DRONE_ID_SYSTEM: {
         mavlink_msg_open_drone_id_system_decode(&msg, &system);
+        generation.system++;
         if (g.options & OPTIONS_PRINT_RID_MAVLINK) {
             Serial.printf("MAVLink: got System\n");
         }
@@ -205,6 +234,7 @@ void MAVLinkSerial::process_packet(mavlink_status_t &status, mavlink_message_t &
         system.operator_longitude = pkt_system_update.operator_longitude;
         system.operator_altitude_geo = pkt_system_update.operator_altitude_geo;
         system.timestamp = pkt_system_update.timestamp;
+        generation.system++;
         if (last_system_ms != 0) {
             // we can only mark system as updated if we have the other
             // information already
@@ -219,6 +249,7 @@ void MAVLinkSerial::process_packet(mavlink_status_t &status, mavlink_message_t &
     }
     case MAVLINK_MSG_ID_OPEN_DRONE_ID_OPERATOR_ID: {
         mavlink_msg_open_drone_id_operator_id_decode(&msg, &operator_id);
+        generation.operator_id++;
         if (g.options & OPTIONS_PRINT_RID_MAVLINK) {
             Serial.printf("MAVLink: got OperatorID\n");
         }
@@ -279,6 +310,16 @@ void MAVLinkSerial::process_packet(mavlink_status_t &status, mavlink_message_t &
                                      g.param_index_float(p));
         break;
     }
+    case MAVLINK_MSG_ID_SYSTEM_TIME: {
+        mavlink_system_time_t pkt;
+        mavlink_msg_system_time_decode(&msg, &pkt);
+        last_system_time_ms = now_ms;
+        timesync.set_utc(pkt.time_unix_usec, esp_timer_get_time(), TimeSync::Source::MAVLINK);
+        break;
+    }
+    case MAVLINK_MSG_ID_TIMESYNC:
+        handle_timesync(msg);
+        break;
     case MAVLINK_MSG_ID_SECURE_COMMAND:
     case MAVLINK_MSG_ID_SECURE_COMMAND_REPLY: {
         mavlink_secure_command_t pkt;
@@ -294,10 +335,88 @@ void MAVLinkSerial::process_packet(mavlink_status_t &status, mavlink_message_t &
 
 void MAVLinkSerial::arm_status_send(void)
 {
-    const uint8_t status = parse_fail==nullptr?MAV_ODID_ARM_STATUS_GOOD_TO_ARM:MAV_ODID_ARM_STATUS_PRE_ARM_FAIL_GENERIC;
-    const char *reason = parse_fail==nullptr?"":parse_fail;
+    const uint8_t status = parse_fail==ARM_FAIL_NONE?MAV_ODID_ARM_STATUS_GOOD_TO_ARM:MAV_ODID_ARM_STATUS_PRE_ARM_FAIL_GENERIC;
+    // the send copies the whole field, so the buffer must be full size
+    static char reason[MAVLINK_MSG_OPEN_DRONE_ID_ARM_STATUS_FIELD_ERROR_LEN];
+    format_arm_fail(parse_fail, reason, sizeof(reason));
     mavlink_msg_open_drone_id_arm_status_send(
         chan,
         status,
         reason);
 }
+
+/*
+  send a TIMESYNC request to measure the link round trip time, and
+  ask for SYSTEM_TIME if the flight controller is not sending it
+ */
+void MAVLinkSerial::timesync_send(void)
+{
+    mavlink_timesync_t pkt {};
+    timesync_sent_ns = esp_timer_get_time() * 1000;
+    pkt.ts1 = timesync_sent_ns;
+    mavlink_msg_timesync_send_struct(chan, &pkt);
+
+    if (last_system_time_ms == 0 || millis() - last_system_time_ms > TIMESYNC_INTERVAL_MS) {
+        mavlink_msg_command_long_send(chan,
+                                      mavlink_system.sysid,
+                                      MAV_COMP_ID_AUTOPILOT1,
+                                      MAV_CMD_SET_MESSAGE_INTERVAL,
+                                      0,
+                                      MAVLINK_MSG_ID_SYSTEM_TIME,
+                                      1000000, // 1Hz
+                                      0, 0, 0, 0, 0);
+    }
+}
+
+/*
+  a TIMESYNC with tc1 zero is a request, which we answer with our
+  time. Otherwise it is the reply to our request
+ */
+void MAVLinkSerial::handle_timesync(const mavlink_message_t &msg)
+{
+    mavlink_timesync_t pkt;
+    mavlink_msg_timesync_decode(&msg, &pkt);
+    const int64_t now_ns = esp_timer_get_time() * 1000;
+    if (pkt.tc1 == 0) {
+        mavlink_timesync_t reply {};
+        reply.tc1 = now_ns;
+        reply.ts1 = pkt.ts1;
+        mavlink_msg_timesync_send_struct(chan, &reply);
+        return;
+    }
+    if (pkt.ts1 == timesync_sent_ns && timesync_sent_ns != 0) {
+        timesync.set_rtt(uint32_t((now_ns - pkt.ts1) / 1000));
+    }
+}
+
+#if AP_PROFILE_ENABLED
+/*
+  send profiler results for one stage as a DEBUG_FLOAT_ARRAY, cycling
+  through the stages. The array holds count, min, max and mean in
+  microseconds followed by the log2 cycle histogram
+ */
+void MAVLinkSerial::profile_send(void)
+{
+    const auto stage = Profiler::Stage(profile_stage);
+    profile_stage = (profile_stage + 1) % uint8_t(Profiler::Stage::NUM_STAGES);
+
+    const auto &st = profiler.get_stats(stage);
+    const float cycles_per_us = getCpuFrequencyMhz();
+    float data[58] {};
+    data[0] = st.count;
+    data[1] = st.min_cycles / cycles_per_us;
+    data[2] = st.max_cycles / cycles_per_us;
+    data[3] = st.count ? (float(st.total_cycles) / st.count) / cycles_per_us : 0;
+    for (uint8_t i=0; i<Profiler::NUM_BUCKETS; i++) {
+        data[4+i] = st.hist[i];
+    }
+    // the send copies the whole name field, so pad the stage name out
+    char name[MAVLINK_MSG_DEBUG_FLOAT_ARRAY_FIELD_NAME_LEN] {};
+    strncpy(name, Profiler::stage_name(stage), sizeof(name));
+    mavlink_msg_debug_float_array_send(chan,
+                                       esp_timer_get_time(),
+                                       name,
+                                       uint8_t(stage),
+                                       data);
+}
+#endif
@@ -21,6 +21,11 @@ private:
     uint32_t last_hb_ms;
     uint32_t last_hb_warn_ms;
     uint32_t param_request_last_ms;
+    uint32_t last_profile_ms;
+    uint8_t profile_stage;
+    uint32_t last_timesync_ms;
+    uint32_t last_system_time_ms;
+    int64_t timesync_sent_ns;
     const Parameters::Param *param_next;
 
     void update_receive(void);
@@ -30,4 +35,7 @@ private:
     void handle_secure_command(const mavlink_secure_command_t &pkt);
 
     void arm_status_send(void);
+    void profile_send(void);
+    void timesync_send(void);
+    void handle_timesync(const mavlink_message_t &msg);
 };
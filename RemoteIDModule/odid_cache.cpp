@@ -0,0 +1,154 @@
+/*
+  cache of encoded OpenDroneID messages
+
+  messages are encoded once when their source data changes, then the
+  parse checks, BT4 legacy advertising and the message packs for BT5
+  and WiFi are all built from the cached encoding
+ */
+#include <Arduino.h>
+#include "odid_cache.h"
+
+ODIDCache odid_cache;
+
+/*
+  store a newly encoded message, bumping the generation if anything
+  a transmitter would see has changed
+ */
+bool ODIDCache::update(Entry &e, const uint8_t *encoded, bool encoded_ok, bool valid)
+{
+    if (e.valid != valid ||
+        e.encoded_ok != encoded_ok ||
+        memcmp(e.encoded, encoded, sizeof(e.encoded)) != 0) {
+        memcpy(e.encoded, encoded, sizeof(e.encoded));
+        e.valid = valid;
+        e.encoded_ok = encoded_ok;
+        e.generation++;
+        generation++;
+    }
+    return encoded_ok;
+}
+
+bool ODIDCache::set_basic_id(uint8_t idx, ODID_BasicID_data &data, bool valid)
+{
+    if (idx >= ODID_BASIC_ID_MAX_MESSAGES) {
+        return false;
+    }
+    ODID_BasicID_encoded encoded {};
+    const bool ok = encodeBasicIDMessage(&encoded, &data) == ODID_SUCCESS;
+    return update(entries[uint8_t(Msg::BASIC_ID_1)+idx], (const uint8_t *)&encoded, ok, valid);
+}
+
+bool ODIDCache::set_location(ODID_Location_data &data, bool valid)
+{
+    ODID_Location_encoded encoded {};
+    const bool ok = encodeLocationMessage(&encoded, &data) == ODID_SUCCESS;
+    return update(entries[uint8_t(Msg::LOCATION)], (const uint8_t *)&encoded, ok, valid);
+}
+
+bool ODIDCache::set_self_id(ODID_SelfID_data &data, bool valid)
+{
+    ODID_SelfID_encoded encoded {};
+    const bool ok = encodeSelfIDMessage(&encoded, &data) == ODID_SUCCESS;
+    return update(entries[uint8_t(Msg::SELF_ID)], (const uint8_t *)&encoded, ok, valid);
+}
+
+bool ODIDCache::set_system(ODID_System_data &data, bool valid)
+{
+    ODID_System_encoded encoded {};
+    const bool ok = encodeSystemMessage(&encoded, &data) == ODID_SUCCESS;
+    return update(entries[uint8_t(Msg::SYSTEM)], (const uint8_t *)&encoded, ok, valid);
+}
+
+bool ODIDCache::set_operator_id(ODID_OperatorID_data &data, bool valid)
+{
+    ODID_OperatorID_encoded encoded {};
+    const bool ok = encodeOperatorIDMessage(&encoded, &data) == ODID_SUCCESS;
+    return update(entries[uint8_t(Msg::OPERATOR_ID)], (const uint8_t *)&encoded, ok, valid);
+}
+
+bool ODIDCache::set_auth(uint8_t page, ODID_Auth_data &data, bool valid)
+{
+    if (page >= ODID_AUTH_MAX_PAGES) {
+        return false;
+    }
+    ODID_Auth_encoded encoded {};
+    const bool ok = encodeAuthMessage(&encoded, &data) == ODID_SUCCESS;
+    if (page == 0) {
+        auth_last_page = data.LastPageIndex;
+    }
+    const uint32_t old_generation = generation;
+    const bool ret = update(auth[page], (const uint8_t *)&encoded, ok, valid);
+    if (generation != old_generation) {
+        auth_generation++;
+    }
+    return ret;
+}
+
+uint8_t ODIDCache::num_available(uint8_t msg_mask) const
+{
+    uint8_t count = 0;
+    for (uint8_t i=0; i<uint8_t(Msg::NUM_MSGS); i++) {
+        const auto &e = entries[i];
+        if ((msg_mask & (1U<<i)) && e.valid && e.encoded_ok) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint8_t ODIDCache::auth_pages(void) const
+{
+    if (auth_last_page >= ODID_AUTH_MAX_PAGES) {
+        return 0;
+    }
+    for (uint8_t i=0; i<=auth_last_page; i++) {
+        if (!auth[i].valid || !auth[i].encoded_ok) {
+            return 0;
+        }
+    }
+    return auth_last_page+1;
+}
+
+/*
+  build a message pack, this produces the same bytes as
+  odid_message_build_pack() without encoding each message again. Auth
+  pages go after the Location, as the library puts them
+ */
+int ODIDCache::build_pack(uint8_t *pack, uint32_t buflen, uint8_t msg_mask, uint16_t auth_mask) const
+{
+    static_assert(uint8_t(Msg::NUM_MSGS) <= ODID_PACK_MAX_MESSAGES, "too many messages for a pack");
+    static_assert(sizeof(ODID_Message_encoded) == ODID_MESSAGE_SIZE, "bad message size");
+
+    ODID_MessagePack_data msg_pack;
+    msg_pack.SingleMessageSize = ODID_MESSAGE_SIZE;
+    msg_pack.MsgPackSize = 0;
+    for (uint8_t i=0; i<uint8_t(Msg::NUM_MSGS); i++) {
+        const auto &e = entries[i];
+        if ((msg_mask & (1U<<i)) && e.valid && e.encoded_ok) {
+            memcpy(&msg_pack.Messages[msg_pack.MsgPackSize++], e.encoded, ODID_MESSAGE_SIZE);
+        }
+        if (i != uint8_t(Msg::LOCATION)) {
+            continue;
+        }
+        for (uint8_t page=0; page<ODID_AUTH_MAX_PAGES; page++) {
+            if ((auth_mask & (1U<<page)) == 0 || !auth[page].valid || !auth[page].encoded_ok) {
+                continue;
+            }
+            if (msg_pack.MsgPackSize >= ODID_PACK_MAX_MESSAGES) {
+                return -1;
+            }
+            memcpy(&msg_pack.Messages[msg_pack.MsgPackSize++], auth[page].encoded, ODID_MESSAGE_SIZE);
+        }
+    }
+    if (msg_pack.MsgPackSize == 0) {
+        return -1;
+    }
+    const uint32_t len = sizeof(ODID_MessagePack_encoded) - (ODID_PACK_MAX_MESSAGES - msg_pack.MsgPackSize) * ODID_MESSAGE_SIZE;
+    if (len > buflen) {
+        return -1;
+    }
+    if (encodeMessagePack((ODID_MessagePack_encoded *)pack, &msg_pack) != ODID_SUCCESS) {
+        return -1;
+    }
+    return len;
+}
@@ -0,0 +1,100 @@
+/*
+  cache of encoded OpenDroneID messages, shared by the parse checks
+  and all of the transmitters
+ */
+#pragma once
+
+#include <stdint.h>
+#include <opendroneid.h>
+
+class ODIDCache {
+public:
+    // in the order odid_message_build_pack() puts them in a pack
+    enum class Msg : uint8_t {
+        BASIC_ID_1=0,
+        BASIC_ID_2,
+        LOCATION,
+        SELF_ID,
+        SYSTEM,
+        OPERATOR_ID,
+        NUM_MSGS
+    };
+
+    // mask of every Msg
+    static const uint8_t ALL_MSGS = (1U<<uint8_t(Msg::NUM_MSGS))-1;
+
+    /*
+      encode a message into the cache. The message is encoded even
+      when not valid so the range checks are always done. Returns
+      true if the message encoded successfully
+     */
+    bool set_basic_id(uint8_t idx, ODID_BasicID_data &data, bool valid);
+    bool set_location(ODID_Location_data &data, bool valid);
+    bool set_self_id(ODID_SelfID_data &data, bool valid);
+    bool set_system(ODID_System_data &data, bool valid);
+    bool set_operator_id(ODID_OperatorID_data &data, bool valid);
+    bool set_auth(uint8_t page, ODID_Auth_data &data, bool valid);
+
+    // true if a message is valid and encoded successfully
+    bool available(Msg msg) const {
+        const auto &e = entries[uint8_t(msg)];
+        return e.valid && e.encoded_ok;
+    }
+
+    const uint8_t *get(Msg msg) const {
+        return entries[uint8_t(msg)].encoded;
+    }
+
+    // generation of a message, changes when its encoded bytes change
+    uint32_t get_generation(Msg msg) const {
+        return entries[uint8_t(msg)].generation;
+    }
+
+    // generation of the whole cache, changes when any message changes
+    uint32_t get_generation(void) const {
+        return generation;
+    }
+
+    // number of the messages in msg_mask which are available
+    uint8_t num_available(uint8_t msg_mask=ALL_MSGS) const;
+
+    /*
+      number of auth pages to send, zero unless every page up to the
+      last page index of page 0 is available
+     */
+    uint8_t auth_pages(void) const;
+
+    const uint8_t *get_auth(uint8_t page) const {
+        return auth[page].encoded;
+    }
+
+    // changes when any auth page changes
+    uint32_t get_auth_generation(void) const {
+        return auth_generation;
+    }
+
+    /*
+      build a message pack from the available messages in msg_mask
+      and the auth pages in auth_mask, returns the length of the pack
+      or -1 on error
+     */
+    int build_pack(uint8_t *pack, uint32_t buflen, uint8_t msg_mask=ALL_MSGS, uint16_t auth_mask=0) const;
+
+private:
+    struct Entry {
+        uint8_t encoded[ODID_MESSAGE_SIZE];
+        bool valid;
+        bool encoded_ok;
+        uint32_t generation;
+    } entries[uint8_t(Msg::NUM_MSGS)];
+
+    Entry auth[ODID_AUTH_MAX_PAGES];
+    uint8_t auth_last_page;
+    uint32_t auth_generation;
+
+    uint32_t generation;
+
+    bool update(Entry &e, const uint8_t *encoded, bool encoded_ok, bool valid);
+};
+
+extern ODIDCache odid_cache;
@@ -10,3 +10,9 @@
 
 // do we support MAVLink connnection to flight controller?
 #define AP_MAVLINK_ENABLED 1
+
+// do we support the per stage profiler? Enabled at runtime with the
+// OPTIONS parameter
+#ifndef AP_PROFILE_ENABLED
+#define AP_PROFILE_ENABLED 1
+#endif
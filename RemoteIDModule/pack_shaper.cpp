@@ -0,0 +1,68 @@
+/*
+  shaping of the BT5 and WiFi message packs
+
+  a pack with every message is close to the maximum size on every
+  transmit, even though BasicID, SelfID and OperatorID almost never
+  change. With PACK_STATIC_DIV above 1 each static message goes in one
+  of every PACK_STATIC_DIV packs, spread so the packs stay a similar
+  length, which cuts the average airtime. This matters most on the
+  coded PHY, where each byte takes eight times as long to send. A
+  static message that changes goes in the next pack on every job.
+
+  The turns count packs, so on a slow job PACK_STATIC_MAX bounds the
+  time a static message can go unsent on that job
+ */
+#include <Arduino.h>
+#include "pack_shaper.h"
+#include "parameters.h"
+#include "util.h"
+
+PackShaper pack_shaper;
+
+// the messages which take turns
+static const ODIDCache::Msg static_msgs[] {
+    ODIDCache::Msg::BASIC_ID_1,
+    ODIDCache::Msg::BASIC_ID_2,
+    ODIDCache::Msg::SELF_ID,
+    ODIDCache::Msg::OPERATOR_ID,
+};
+
+uint8_t PackShaper::select(TxScheduler::Job job, const ODIDCache &cache)
+{
+    auto &j = jobs[uint8_t(job)];
+    uint8_t mask = ODIDCache::ALL_MSGS;
+
+    const uint32_t now_ms = millis();
+    const uint8_t div = g.pack_static_div;
+    if (div > 1) {
+        const uint32_t max_ms = g.pack_static_max * 1000;
+        for (uint8_t i=0; i<ARRAY_SIZE(static_msgs); i++) {
+            const uint8_t m = uint8_t(static_msgs[i]);
+            if ((j.seq + i) % div != 0 &&
+                j.sent_generation[m] == cache.get_generation(static_msgs[i]) &&
+                (max_ms == 0 || now_ms - j.sent_ms[m] < max_ms)) {
+                mask &= ~(1U<<m);
+            }
+        }
+        j.seq++;
+    }
+
+    for (uint8_t m=0; m<uint8_t(ODIDCache::Msg::NUM_MSGS); m++) {
+        if (mask & (1U<<m)) {
+            j.sent_generation[m] = cache.get_generation(ODIDCache::Msg(m));
+            j.sent_ms[m] = now_ms;
+        }
+    }
+    j.packs++;
+    j.msgs += cache.num_available(mask);
+    return mask;
+}
+
+float PackShaper::get_avg_msgs(TxScheduler::Job job) const
+{
+    const auto &j = jobs[uint8_t(job)];
+    if (j.packs == 0) {
+        return 0;
+    }
+    return float(j.msgs) / j.packs;
+}
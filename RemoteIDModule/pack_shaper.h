@@ -0,0 +1,34 @@
+/*
+  shaping of the BT5 and WiFi message packs
+ */
+#pragma once
+
+#include <stdint.h>
+#include "scheduler.h"
+#include "odid_cache.h"
+
+class PackShaper {
+public:
+    /*
+      choose the messages for the next pack on a job, returns a mask
+      of ODIDCache::Msg. Location and System go in every pack, the
+      static messages take turns unless they have changed since the
+      job last sent them or are due under PACK_STATIC_MAX
+     */
+    uint8_t select(TxScheduler::Job job, const ODIDCache &cache);
+
+    // average number of messages in the packs of a job, 0 if none sent
+    float get_avg_msgs(TxScheduler::Job job) const;
+
+private:
+    struct {
+        uint32_t seq;
+        // cache generation of each message when last put in a pack
+        uint32_t sent_generation[uint8_t(ODIDCache::Msg::NUM_MSGS)];
+        uint32_t sent_ms[uint8_t(ODIDCache::Msg::NUM_MSGS)];
+        uint32_t packs;
+        uint32_t msgs;
+    } jobs[uint8_t(TxScheduler::Job::NUM_JOBS)];
+};
+
+extern PackShaper pack_shaper;
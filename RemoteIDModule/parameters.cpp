@@ -8,6 +8,7 @@
 
 Parameters g;
 static nvs_handle handle;
+static uint32_t generation;
 
 const Parameters::Param Parameters::params[] = {
     { "LOCK_LEVEL",        Parameters::ParamType::INT8,  (const void*)&g.lock_level,       0, -1, 2 },
@@ -29,6 +30,8 @@ const Parameters::Param Parameters::params[] = {
     { "BT4_POWER",         Parameters::ParamType::FLOAT,  (const void*)&g.bt4_power,        18, -27, 18 },
     { "BT5_RATE",          Parameters::ParamType::FLOAT,  (const void*)&g.bt5_rate,         1, 0, 5 },
     { "BT5_POWER",         Parameters::ParamType::FLOAT,  (const void*)&g.bt5_power,        18, -27, 18 },
+    { "BT5_1M_RATE",       Parameters::ParamType::FLOAT,  (const void*)&g.bt5_1m_rate,      0, 0, 5 },
+    { "BT5_1M_POWER",      Parameters::ParamType::FLOAT,  (const void*)&g.bt5_1m_power,     18, -27, 18 },
     { "WEBSERVER_EN",      Parameters::ParamType::UINT8,  (const void*)&g.webserver_enable, 1, 0, 1 },
     { "WIFI_SSID",         Parameters::ParamType::CHAR20, (const void*)&g.wifi_ssid, },
     { "WIFI_PASSWORD",     Parameters::ParamType::CHAR20, (const void*)&g.wifi_password,    0, 0, 0, PARAM_FLAG_PASSWORD, 8 },
@@ -41,6 +44,24 @@ const Parameters::Param Parameters::params[] = {
     { "PUBLIC_KEY5",       Parameters::ParamType::CHAR64, (const void*)&g.public_keys[4], },
     { "MAVLINK_SYSID",     Parameters::ParamType::UINT8,  (const void*)&g.mavlink_sysid,    0, 0, 254 },
     { "OPTIONS",           Parameters::ParamType::UINT8,  (const void*)&g.options,          0, 0, 254 },
+    { "EMERG_BURST",       Parameters::ParamType::FLOAT,  (const void*)&g.emergency_burst,  10, 0, 60 },
+    { "PWR_MODE",          Parameters::ParamType::UINT8,  (const void*)&g.power_mode,       0, 0, 2 }, // 0:always on, 1:clock scaling, 2:light sleep, needs all radios off and runs as 1 otherwise
+    { "GND_RATE_SCALE",    Parameters::ParamType::FLOAT,  (const void*)&g.gnd_rate_scale,   1, 0.1, 1 },
+    { "GND_POWER_DROP",    Parameters::ParamType::FLOAT,  (const void*)&g.gnd_power_drop,   0, 0, 30 },
+    { "DR_HORIZON",        Parameters::ParamType::FLOAT,  (const void*)&g.dr_horizon,       0, 0, 5 },
+    { "BT4_MODE",          Parameters::ParamType::UINT8,  (const void*)&g.bt4_mode,         0, 0, 1 },
+    { "BT4_W_LOC",         Parameters::ParamType::UINT8,  (const void*)&g.bt4_w_loc,        3, 0, 10 },
+    { "BT4_W_BASICID",     Parameters::ParamType::UINT8,  (const void*)&g.bt4_w_basicid,    1, 0, 10 },
+    { "BT4_W_SELFID",      Parameters::ParamType::UINT8,  (const void*)&g.bt4_w_selfid,     1, 0, 10 },
+    { "BT4_W_SYSTEM",      Parameters::ParamType::UINT8,  (const void*)&g.bt4_w_system,     1, 0, 10 },
+    { "BT4_W_OPID",        Parameters::ParamType::UINT8,  (const void*)&g.bt4_w_opid,       1, 0, 10 },
+    { "BT4_W_NAME",        Parameters::ParamType::UINT8,  (const void*)&g.bt4_w_name,       1, 0, 10 },
+    { "BT4_STATIC_MAX",    Parameters::ParamType::FLOAT,  (const void*)&g.bt4_static_max,   3, 0, 10 },
+    { "BLE_SKIP_SAME",     Parameters::ParamType::UINT8,  (const void*)&g.ble_skip_same,    0, 0, 1 },
+    { "AUTH_BUDGET",       Parameters::ParamType::FLOAT,  (const void*)&g.auth_budget,      10, 0, 50 },
+    { "WIFI_NAN_SYNC",     Parameters::ParamType::UINT8,  (const void*)&g.wifi_nan_sync,    0, 0, 16 },
+    { "PACK_STATIC_DIV",   Parameters::ParamType::UINT8,  (const void*)&g.pack_static_div,  1, 1, 10 },
+    { "PACK_STATIC_MAX",   Parameters::ParamType::FLOAT,  (const void*)&g.pack_static_max,  3, 0, 10 },
     { "TO_DEFAULTS",     Parameters::ParamType::UINT8,  (const void*)&g.to_factory_defaults,    0, 0, 1 }, //if set to 1, reset to factory defaults and make 0.
     { "DONE_INIT",         Parameters::ParamType::UINT8,  (const void*)&g.done_init,        0, 0, 0, PARAM_FLAG_HIDDEN},
     { "",                  Parameters::ParamType::NONE,   nullptr,  },
@@ -63,6 +84,8 @@ uint16_t Parameters::param_count_float(void)
         case ParamType::FLOAT:
             count++;
             break;
+        default:
+            break;
         }
     }
     // remove 1 for DONE_INIT
@@ -89,6 +112,8 @@ int16_t Parameters::param_index_float(const Parameters::Param *f)
             }
             count++;
             break;
+        default:
+            break;
         }
     }
     return -1;
@@ -138,6 +163,8 @@ const Parameters::Param *Parameters::find_by_index_float(uint16_t index)
             }
             count++;
             break;
+        default:
+            break;
         }
     }
     return nullptr;
@@ -147,6 +174,7 @@ void Parameters::Param::set_uint8(uint8_t v) const
 {
     auto *p = (uint8_t *)ptr;
     *p = v;
+    generation++;
     nvs_set_u8(handle, name, *p);
     if (strcmp(name, "TO_DEFAULTS") == 0) {
         if (v == 1) {
@@ -160,6 +188,7 @@ void Parameters::Param::set_int8(int8_t v) const
 {
     auto *p = (int8_t *)ptr;
     *p = v;
+    generation++;
     nvs_set_i8(handle, name, *p);
 }
 
@@ -167,6 +196,7 @@ void Parameters::Param::set_uint32(uint32_t v) const
 {
     auto *p = (uint32_t *)ptr;
     *p = v;
+    generation++;
     nvs_set_u32(handle, name, *p);
 }
 
@@ -174,6 +204,7 @@ void Parameters::Param::set_float(float v) const
 {
     auto *p = (float *)ptr;
     *p = v;
+    generation++;
     union {
         float f;
         uint32_t u32;
@@ -190,6 +221,7 @@ void Parameters::Param::set_char20(const char *v) const
     memset((void*)ptr, 0, 21);
     strncpy((char *)ptr, v, 20);
     nvs_set_str(handle, name, v);
+    generation++;
 }
 
 void Parameters::Param::set_char64(const char *v) const
@@ -200,6 +232,7 @@ void Parameters::Param::set_char64(const char *v) const
     memset((void*)ptr, 0, 65);
     strncpy((char *)ptr, v, 64);
     nvs_set_str(handle, name, v);
+    generation++;
 }
 
 uint8_t Parameters::Param::get_uint8() const
@@ -280,6 +313,8 @@ void Parameters::Param::set_as_float(float v) const
         case ParamType::FLOAT:
             set_float(v);
             break;
+        default:
+            break;
     }
 }
 
@@ -303,6 +338,8 @@ void Parameters::load_defaults(void)
         case ParamType::FLOAT:
             *(float *)p.ptr = p.default_value;
             break;
+        default:
+            break;
         }
     }
 }
@@ -340,6 +377,8 @@ void Parameters::init(void)
             nvs_get_str(handle, p.name, (char *)p.ptr, &len);
             break;
         }
+        default:
+            break;
         }
     }
 
@@ -372,6 +411,11 @@ void Parameters::init(void)
     }
 }
 
+uint32_t Parameters::get_generation(void) const
+{
+    return generation;
+}
+
 /*
   check if BasicID info is filled in with parameters
  */
@@ -440,6 +484,8 @@ bool Parameters::set_by_name_string(const char *name, const char *s)
         case ParamType::CHAR64:
             f->set_char64(s);
             return true;
+        default:
+            break;
     }
     return false;
 }
@@ -33,6 +33,8 @@ public:
     float bt4_power;
     float bt5_rate;
     float bt5_power;
+    float bt5_1m_rate;
+    float bt5_1m_power;
     uint8_t done_init;
     uint8_t webserver_enable;
     uint8_t mavlink_sysid;
@@ -41,6 +43,24 @@ public:
     uint8_t wifi_channel = 6;
     uint8_t to_factory_defaults = 0;
     uint8_t options;
+    uint8_t power_mode;
+    float emergency_burst;
+    float gnd_rate_scale;
+    float gnd_power_drop;
+    float dr_horizon;
+    uint8_t bt4_mode;
+    uint8_t bt4_w_loc;
+    uint8_t bt4_w_basicid;
+    uint8_t bt4_w_selfid;
+    uint8_t bt4_w_system;
+    uint8_t bt4_w_opid;
+    uint8_t bt4_w_name;
+    float bt4_static_max;
+    uint8_t ble_skip_same;
+    float auth_budget;
+    uint8_t pack_static_div;
+    float pack_static_max;
+    uint8_t wifi_nan_sync;
     struct {
         char b64_key[64];
     } public_keys[MAX_PUBLIC_KEYS];
@@ -87,6 +107,11 @@ public:
 
     void init(void);
 
+    /*
+      generation counter, incremented on any parameter change
+     */
+    uint32_t get_generation(void) const;
+
     bool have_basic_id_info(void) const;
     bool have_basic_id_2_info(void) const;
 
@@ -114,5 +139,8 @@ private:
 #define OPTIONS_FORCE_ARM_OK (1U<<0)
 #define OPTIONS_DONT_SAVE_BASIC_ID_TO_PARAMETERS (1U<<1)
 #define OPTIONS_PRINT_RID_MAVLINK (1U<<2)
+#define OPTIONS_PROFILE (1U<<3)
+// esp_wifi_set_vendor_ie() replaces an installed IE, so skip removing it first
+#define OPTIONS_WIFI_IE_REPLACE (1U<<4)
 
 extern Parameters g;
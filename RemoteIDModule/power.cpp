@@ -0,0 +1,163 @@
+/*
+  power management with esp_pm
+
+  the ingest and radio tasks hold a CPU frequency lock while they are
+  working. With no lock held esp_pm drops the CPU clock, and in
+  LIGHT_SLEEP mode the idle task enters automatic light sleep until the
+  next task deadline or activity on the MAVLink UART or CAN bus.
+  Light sleep is only possible with the radios off, as the WiFi and BT
+  drivers hold their own locks while the radios are on.
+
+  The time each lock is held is measured in all modes, so the duty
+  cycle of the always on loop can be compared with the power saving
+  modes
+ */
+#include "options.h"
+#include <Arduino.h>
+#include "power.h"
+#include "util.h"
+#include <esp_timer.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/uart.h>
+#include <driver/gpio.h>
+#endif
+
+PowerManager power;
+
+// window over which the duty cycle is measured
+#define POWER_DUTY_WINDOW_US 1000000
+
+/*
+  the lowest clock we scale to. At 80MHz and above the APB clock stays
+  at 80MHz, so the UART and TWAI baud rates are not disturbed
+ */
+#define POWER_MIN_FREQ_MHZ 80
+
+// UART edges needed to wake from light sleep, the bytes that wake us
+// are lost but MAVLink resyncs on the next packet
+#define POWER_UART_WAKE_THRESHOLD 3
+
+const char *PowerManager::mode_name(Mode m)
+{
+    switch (m) {
+    case Mode::ALWAYS_ON:
+        return "ALWAYS_ON";
+    case Mode::FREQ_SCALE:
+        return "FREQ_SCALE";
+    case Mode::LIGHT_SLEEP:
+        return "LIGHT_SLEEP";
+    default:
+        break;
+    }
+    return "UNKNOWN";
+}
+
+void PowerManager::init(Mode requested, bool radios_on)
+{
+    mode = Mode::ALWAYS_ON;
+
+#if CONFIG_PM_ENABLE
+    if (requested == Mode::ALWAYS_ON) {
+        return;
+    }
+
+#if CONFIG_IDF_TARGET_ESP32S3
+    esp_pm_config_esp32s3_t cfg {};
+#elif CONFIG_IDF_TARGET_ESP32C3
+    esp_pm_config_esp32c3_t cfg {};
+#else
+    esp_pm_config_esp32_t cfg {};
+#endif
+    cfg.max_freq_mhz = getCpuFrequencyMhz();
+    cfg.min_freq_mhz = MIN(POWER_MIN_FREQ_MHZ, cfg.max_freq_mhz);
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    if (requested == Mode::LIGHT_SLEEP && radios_on) {
+        // the radio drivers' own locks would keep us out of light sleep
+        Serial.printf("Light sleep needs the radios off, scaling the clock only\n");
+        requested = Mode::FREQ_SCALE;
+    }
+    cfg.light_sleep_enable = (requested == Mode::LIGHT_SLEEP);
+#else
+    // light sleep needs a tickless idle build
+    requested = Mode::FREQ_SCALE;
+    (void)radios_on;
+#endif
+
+    if (esp_pm_configure(&cfg) != ESP_OK) {
+        Serial.printf("esp_pm_configure failed\n");
+        return;
+    }
+
+    static const char *lock_names[NUM_LOCKS] { "ingest", "radio" };
+    for (uint8_t i=0; i<NUM_LOCKS; i++) {
+        esp_pm_lock_handle_t handle = nullptr;
+        if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, lock_names[i], &handle) == ESP_OK) {
+            locks[i].handle = handle;
+        }
+    }
+
+    if (requested == Mode::LIGHT_SLEEP) {
+        setup_wakeup();
+    }
+    mode = requested;
+#else
+    (void)requested;
+    (void)radios_on;
+#endif
+}
+
+/*
+  wake early from light sleep on transport activity
+ */
+void PowerManager::setup_wakeup(void)
+{
+#if CONFIG_PM_ENABLE
+    // Serial1 is UART1, used for MAVLink
+    uart_set_wakeup_threshold(UART_NUM_1, POWER_UART_WAKE_THRESHOLD);
+    esp_sleep_enable_uart_wakeup(UART_NUM_1);
+
+#if defined(PIN_CAN_RX)
+    /*
+      the bus idles recessive (high), wake on a dominant bit. Note the
+      TWAI driver holds its own APB lock while started, which blocks
+      light sleep while the CAN bus is in use
+     */
+    gpio_wakeup_enable(PIN_CAN_RX, GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+#endif
+#endif
+}
+
+void PowerManager::acquire(Lock lock)
+{
+    auto &l = locks[uint8_t(lock)];
+#if CONFIG_PM_ENABLE
+    if (l.handle != nullptr) {
+        esp_pm_lock_acquire((esp_pm_lock_handle_t)l.handle);
+    }
+#endif
+    l.start_us = esp_timer_get_time();
+}
+
+void PowerManager::release(Lock lock)
+{
+    auto &l = locks[uint8_t(lock)];
+    const int64_t now_us = esp_timer_get_time();
+    if (l.window_start_us == 0) {
+        l.window_start_us = l.start_us;
+    }
+    l.busy_us += now_us - l.start_us;
+    const int64_t window_us = now_us - l.window_start_us;
+    if (window_us >= POWER_DUTY_WINDOW_US) {
+        l.duty = float(l.busy_us) / window_us;
+        l.busy_us = 0;
+        l.window_start_us = now_us;
+    }
+#if CONFIG_PM_ENABLE
+    if (l.handle != nullptr) {
+        esp_pm_lock_release((esp_pm_lock_handle_t)l.handle);
+    }
+#endif
+}
@@ -0,0 +1,85 @@
+/*
+  power management. The CPU only needs to run at full clock around
+  transport ingest and radio transmits, between them esp_pm can scale
+  the clock down and optionally enter automatic light sleep
+ */
+#pragma once
+
+#include <stdint.h>
+
+class PowerManager {
+public:
+    // values of the PWR_MODE parameter
+    enum class Mode : uint8_t {
+        ALWAYS_ON=0,    // full clock all the time
+        FREQ_SCALE=1,   // scale the CPU clock down between bursts
+        LIGHT_SLEEP=2,  // scale the clock and light sleep when idle, radios off only
+    };
+
+    // each lock must only be taken and released from one task
+    enum class Lock : uint8_t {
+        INGEST=0,
+        RADIO,
+        NUM_LOCKS
+    };
+
+    /*
+      configure power management. If the firmware is built without
+      power management support we fall back to a lower mode.
+      radios_on is true if WiFi or BLE will be used. Their drivers
+      then hold power locks of their own, the softAP has no modem sleep
+      and BLE advertising runs without it, so light sleep can't happen
+      and LIGHT_SLEEP runs as FREQ_SCALE
+     */
+    void init(Mode requested, bool radios_on);
+
+    void acquire(Lock lock);
+    void release(Lock lock);
+
+    // the mode in use, may be lower than requested
+    Mode get_mode(void) const {
+        return mode;
+    }
+
+    // fraction of time a lock was held over the last window
+    float get_duty_cycle(Lock lock) const {
+        return locks[uint8_t(lock)].duty;
+    }
+
+    static const char *mode_name(Mode mode);
+
+private:
+    static const uint8_t NUM_LOCKS = uint8_t(Lock::NUM_LOCKS);
+
+    Mode mode;
+
+    struct LockState {
+        void *handle;
+        int64_t start_us;
+        int64_t window_start_us;
+        int64_t busy_us;
+        float duty;
+    } locks[NUM_LOCKS];
+
+    void setup_wakeup(void);
+};
+
+extern PowerManager power;
+
+/*
+  hold a power lock for the enclosing scope
+ */
+class PowerLockScope {
+public:
+    PowerLockScope(PowerManager::Lock _lock) :
+        lock(_lock) {
+        power.acquire(lock);
+    }
+
+    ~PowerLockScope() {
+        power.release(lock);
+    }
+
+private:
+    const PowerManager::Lock lock;
+};
@@ -0,0 +1,112 @@
+/*
+  lightweight per stage profiler using the CPU cycle counter
+
+  each stage keeps min, max, mean and a log2 histogram of the cycles
+  it took. Profiling is enabled at runtime with the OPTIONS parameter
+  and can be compiled out with AP_PROFILE_ENABLED
+ */
+#include "profile.h"
+#include "parameters.h"
+#include "util.h"
+
+Profiler profiler;
+
+bool Profiler::enabled(void)
+{
+    return (g.options & OPTIONS_PROFILE) != 0;
+}
+
+const char *Profiler::stage_name(Stage stage)
+{
+    // names are at most 10 characters to fit in DEBUG_FLOAT_ARRAY
+    switch (stage) {
+    case Stage::LOOP:
+        return "LOOP";
+    case Stage::MAVLINK_UPDATE:
+        return "MAVLINK";
+    case Stage::DRONECAN_UPDATE:
+        return "DRONECAN";
+    case Stage::LED_UPDATE:
+        return "LED";
+    case Stage::WEBIF_UPDATE:
+        return "WEBIF";
+    case Stage::SET_DATA:
+        return "SET_DATA";
+    case Stage::CHECK_PARSE:
+        return "CHK_PARSE";
+    case Stage::TX_WIFI_NAN:
+        return "TX_NAN";
+    case Stage::TX_WIFI_BEACON:
+        return "TX_BEACON";
+    case Stage::TX_BT5:
+        return "TX_BT5";
+    case Stage::TX_BT4:
+        return "TX_BT4";
+    case Stage::TX_BT5_1M:
+        return "TX_BT5_1M";
+    default:
+        break;
+    }
+    return "UNKNOWN";
+}
+
+void Profiler::record(Stage stage, uint32_t cycles)
+{
+    const uint8_t idx = uint8_t(stage);
+    if (idx >= uint8_t(Stage::NUM_STAGES)) {
+        return;
+    }
+    auto &s = stats[idx];
+    if (s.count == 0 || cycles < s.min_cycles) {
+        s.min_cycles = cycles;
+    }
+    if (cycles > s.max_cycles) {
+        s.max_cycles = cycles;
+    }
+    s.total_cycles += cycles;
+    const uint8_t bucket = cycles == 0 ? 0 : 32 - __builtin_clz(cycles);
+    s.hist[MIN(bucket, NUM_BUCKETS-1)]++;
+    s.count++;
+}
+
+void Profiler::reset(void)
+{
+    memset(stats, 0, sizeof(stats));
+}
+
+String profile_json(void)
+{
+    const float cycles_per_us = getCpuFrequencyMhz();
+    String s = "{";
+    s += "\"enabled\" : " + String(Profiler::enabled() ? "true" : "false") + ",";
+    s += "\"cpu_mhz\" : " + String(getCpuFrequencyMhz()) + ",";
+    s += "\"stages\" : {";
+    for (uint8_t i=0; i<uint8_t(Profiler::Stage::NUM_STAGES); i++) {
+        const auto stage = Profiler::Stage(i);
+        const auto &st = profiler.get_stats(stage);
+        const float mean = st.count ? float(st.total_cycles) / st.count : 0;
+        if (i != 0) {
+            s += ",";
+        }
+        s += "\"" + String(Profiler::stage_name(stage)) + "\" : {";
+        s += "\"count\" : " + String(st.count) + ",";
+        s += "\"min_us\" : " + String(st.min_cycles / cycles_per_us, 1) + ",";
+        s += "\"max_us\" : " + String(st.max_cycles / cycles_per_us, 1) + ",";
+        s += "\"mean_us\" : " + String(mean / cycles_per_us, 1) + ",";
+        s += "\"hist\" : [";
+        // trim trailing empty buckets
+        uint8_t nbuckets = Profiler::NUM_BUCKETS;
+        while (nbuckets > 0 && st.hist[nbuckets-1] == 0) {
+            nbuckets--;
+        }
+        for (uint8_t b=0; b<nbuckets; b++) {
+            if (b != 0) {
+                s += ",";
+            }
+            s += String(st.hist[b]);
+        }
+        s += "]}";
+    }
+    s += "}}";
+    return s;
+}
@@ -0,0 +1,92 @@
+/*
+  lightweight per stage profiler using the CPU cycle counter
+ */
+#pragma once
+
+#include "options.h"
+#include <stdint.h>
+#include <Arduino.h>
+
+class Profiler {
+public:
+    enum class Stage : uint8_t {
+        LOOP=0,
+        MAVLINK_UPDATE,
+        DRONECAN_UPDATE,
+        LED_UPDATE,
+        WEBIF_UPDATE,
+        SET_DATA,
+        CHECK_PARSE,
+        TX_WIFI_NAN,
+        TX_WIFI_BEACON,
+        TX_BT5,
+        TX_BT4,
+        TX_BT5_1M,
+        NUM_STAGES
+    };
+
+    // log2 histogram, bucket n counts samples of [2^(n-1), 2^n) cycles
+    static const uint8_t NUM_BUCKETS = 32;
+
+    struct StageStats {
+        uint32_t count;
+        uint32_t min_cycles;
+        uint32_t max_cycles;
+        uint64_t total_cycles;
+        uint32_t hist[NUM_BUCKETS];
+    };
+
+    // true if profiling is enabled with the OPTIONS parameter
+    static bool enabled(void);
+
+    void record(Stage stage, uint32_t cycles);
+    void reset(void);
+
+    const StageStats &get_stats(Stage stage) const {
+        return stats[uint8_t(stage)];
+    }
+
+    static const char *stage_name(Stage stage);
+
+private:
+    StageStats stats[uint8_t(Stage::NUM_STAGES)];
+};
+
+extern Profiler profiler;
+
+/*
+  time the enclosing scope. Each stage must only be recorded from one
+  task, readers may see a partially updated sample which is fine for
+  diagnostics
+ */
+class ProfileScope {
+public:
+    ProfileScope(Profiler::Stage _stage) :
+        stage(_stage),
+        active(Profiler::enabled()),
+        start(active ? ESP.getCycleCount() : 0) {}
+
+    ~ProfileScope() {
+        if (active) {
+            profiler.record(stage, ESP.getCycleCount() - start);
+        }
+    }
+
+private:
+    const Profiler::Stage stage;
+    const bool active;
+    const uint32_t start;
+};
+
+#if AP_PROFILE_ENABLED
+#define PROFILE_CONCAT2(a,b) a ## b
+#define PROFILE_CONCAT(a,b) PROFILE_CONCAT2(a,b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(_profile_, __LINE__)(Profiler::Stage::stage)
+#else
+#define PROFILE_SCOPE(stage)
+#endif
+
+/*
+  profiler results as json for the web interface
+ */
+String profile_json(void);
@@ -9,7 +9,7 @@ const ROMFS::embedded_file *ROMFS::find(const char *fname)
     for (const auto &f : files) {
         if (strcmp(fname, f.filename) == 0) {
             Serial.printf("ROMFS Returning '%s' size=%u len=%u\n",
-                          fname, f.size, strlen((const char *)f.contents));
+                          fname, unsigned(f.size), unsigned(strlen((const char *)f.contents)));
             return &f;
         }
     }
@@ -49,7 +49,7 @@ int ROMFS_Stream::available(void)
 size_t ROMFS_Stream::read(uint8_t* buf, size_t size)
 {
     const auto avail = available();
-    if (size > avail) {
+    if (size > size_t(avail)) {
         size = avail;
     }
     memcpy(buf, &f.contents[offset], size);
@@ -0,0 +1,220 @@
+/*
+  deadline driven scheduler for radio transmit jobs
+
+  each job has a period held as integer microseconds plus a
+  fractional accumulator, and deadlines are advanced from the previous
+  deadline rather than from the time the job ran, so the configured
+  rates are met without drift
+
+  the task sleeps in whole RTOS ticks, so a job may run up to one tick
+  before its deadline rather than the task spinning out the remainder
+ */
+#include <Arduino.h>
+#include "scheduler.h"
+#include "util.h"
+
+TxScheduler tx_sched;
+
+// the RTOS tick, a job may run up to one tick early
+#define SCHED_TICK_US (portTICK_PERIOD_MS*1000U)
+
+/*
+  return true if time a is before time b, allowing for wrap
+ */
+static inline bool time_before(uint32_t a, uint32_t b)
+{
+    return int32_t(a - b) < 0;
+}
+
+const char *TxScheduler::job_name(Job job)
+{
+    switch (job) {
+    case Job::WIFI_NAN:
+        return "WIFI_NAN";
+    case Job::WIFI_BEACON:
+        return "WIFI_BCN";
+    case Job::BT5:
+        return "BT5";
+    case Job::BT4:
+        return "BT4";
+    case Job::BT5_1M:
+        return "BT5_1M";
+    default:
+        break;
+    }
+    return "UNKNOWN";
+}
+
+void TxScheduler::tx_failed(Job job)
+{
+    const uint8_t idx = uint8_t(job);
+    if (idx < NUM_JOBS) {
+        jobs[idx].stats.not_sent++;
+    }
+}
+
+void TxScheduler::set_rate(Job job, float rate_hz)
+{
+    const uint8_t idx = uint8_t(job);
+    if (idx >= NUM_JOBS) {
+        return;
+    }
+    auto &j = jobs[idx];
+    if (rate_hz == j.rate_hz) {
+        return;
+    }
+    j.rate_hz = rate_hz;
+    if (rate_hz <= 0) {
+        j.enabled = false;
+        queue_remove(idx);
+        return;
+    }
+
+    const double period = 1.0e6 / rate_hz;
+    j.period_us = uint32_t(period);
+    j.period_frac = uint16_t((period - j.period_us) * 65536);
+    j.frac_accum = 0;
+
+    const uint32_t now_us = micros();
+    if (!j.enabled) {
+        // a newly enabled job is due immediately
+        j.enabled = true;
+        j.deadline_us = now_us;
+        j.last_run_us = 0;
+    } else if (time_before(now_us + j.period_us, j.deadline_us)) {
+        // rate increased, don't wait out the old longer period
+        j.deadline_us = now_us + j.period_us;
+    }
+    queue_remove(idx);
+    queue_insert(idx);
+}
+
+void TxScheduler::trigger(Job job)
+{
+    const uint8_t idx = uint8_t(job);
+    if (idx >= NUM_JOBS || !jobs[idx].enabled) {
+        return;
+    }
+    jobs[idx].deadline_us = micros();
+    jobs[idx].frac_accum = 0;
+    queue_remove(idx);
+    queue_insert(idx);
+}
+
+void TxScheduler::queue_remove(uint8_t idx)
+{
+    for (uint8_t i=0; i<queue_len; i++) {
+        if (queue[i] == idx) {
+            memmove(&queue[i], &queue[i+1], queue_len-(i+1));
+            queue_len--;
+            return;
+        }
+    }
+}
+
+void TxScheduler::queue_insert(uint8_t idx)
+{
+    const uint32_t deadline_us = jobs[idx].deadline_us;
+    uint8_t i = 0;
+    while (i < queue_len && !time_before(deadline_us, jobs[queue[i]].deadline_us)) {
+        i++;
+    }
+    memmove(&queue[i+1], &queue[i], queue_len-i);
+    queue[i] = idx;
+    queue_len++;
+}
+
+void TxScheduler::advance_deadline(JobState &j)
+{
+    j.deadline_us += j.period_us;
+    j.frac_accum += j.period_frac;
+    if (j.frac_accum >= 65536) {
+        j.frac_accum -= 65536;
+        j.deadline_us++;
+    }
+}
+
+void TxScheduler::update_stats(JobState &j, uint32_t now_us)
+{
+    auto &s = j.stats;
+    // negative when run early
+    const int32_t late_us = int32_t(now_us - j.deadline_us);
+    if (j.last_run_us != 0) {
+        const float period_us = now_us - j.last_run_us;
+        if (s.count < 2) {
+            s.period_us = period_us;
+        } else {
+            s.period_us += 0.05 * (period_us - s.period_us);
+        }
+    }
+    const uint32_t err_us = abs(late_us);
+    s.jitter_us += 0.05 * (err_us - s.jitter_us);
+    if (err_us > s.jitter_max_us) {
+        s.jitter_max_us = err_us;
+    }
+    s.count++;
+    j.last_run_us = now_us;
+}
+
+bool TxScheduler::pop_due(Job &job)
+{
+    if (queue_len == 0) {
+        return false;
+    }
+    const uint8_t idx = queue[0];
+    auto &j = jobs[idx];
+    const uint32_t now_us = micros();
+    if (time_before(now_us + SCHED_TICK_US, j.deadline_us)) {
+        return false;
+    }
+    update_stats(j, now_us);
+    advance_deadline(j);
+    if (!time_before(now_us, j.deadline_us + j.period_us)) {
+        // we have fallen more than a full period behind, most likely
+        // from a blocking call. Resync rather than send a burst
+        j.deadline_us = now_us + j.period_us;
+        j.frac_accum = 0;
+    }
+    queue_remove(idx);
+    queue_insert(idx);
+    job = Job(idx);
+    return true;
+}
+
+uint32_t TxScheduler::time_to_next_us(void) const
+{
+    if (queue_len == 0) {
+        return UINT32_MAX;
+    }
+    const uint32_t now_us = micros();
+    const uint32_t deadline_us = jobs[queue[0]].deadline_us;
+    if (!time_before(now_us, deadline_us)) {
+        return 0;
+    }
+    return deadline_us - now_us;
+}
+
+void TxScheduler::sleep_until_next(uint32_t max_sleep_us)
+{
+    const uint32_t sleep_us = MIN(time_to_next_us(), max_sleep_us);
+    if (sleep_us == 0) {
+        return;
+    }
+    /*
+      round up to whole ticks. The current tick may be partly gone, so
+      the wakeup can be up to a tick before the job's run time, which
+      the early allowance in pop_due() covers. This never busy waits, so
+      lower priority tasks get the CPU on single core boards
+     */
+    // yields the CPU to other tasks, returning early if woken
+    sleep_task.store(xTaskGetCurrentTaskHandle());
+    ulTaskNotifyTake(pdTRUE, (sleep_us + SCHED_TICK_US - 1) / SCHED_TICK_US);
+}
+
+void TxScheduler::wake(void)
+{
+    void *task = sleep_task.load();
+    if (task != nullptr) {
+        xTaskNotifyGive((TaskHandle_t)task);
+    }
+}
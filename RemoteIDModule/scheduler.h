@@ -0,0 +1,100 @@
+/*
+  deadline driven scheduler for radio transmit jobs
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+class TxScheduler {
+public:
+    enum class Job : uint8_t {
+        WIFI_NAN=0,
+        WIFI_BEACON,
+        BT5,
+        BT4,
+        BT5_1M,
+        NUM_JOBS
+    };
+
+    /*
+      set the rate of a job in Hz, a rate of zero disables the job
+     */
+    void set_rate(Job job, float rate_hz);
+
+    /*
+      if a job is due then return it in job and schedule its next
+      deadline. Returns false if no job is due
+     */
+    bool pop_due(Job &job);
+
+    // microseconds until the next deadline, 0 if a job is due now
+    uint32_t time_to_next_us(void) const;
+
+    /*
+      make an enabled job due now, out of its normal cycle. The
+      following deadline is a full period later
+     */
+    void trigger(Job job);
+
+    /*
+      sleep until the next deadline, but no longer than max_sleep_us
+     */
+    void sleep_until_next(uint32_t max_sleep_us);
+
+    /*
+      wake the task sleeping in sleep_until_next() early, may be
+      called from any task
+     */
+    void wake(void);
+
+    /*
+      a job ran but sent nothing, because there was no data, the frame
+      could not be built or the radio API refused it
+     */
+    void tx_failed(Job job);
+
+    struct Stats {
+        uint32_t count;
+        float period_us;       // filtered achieved period
+        float jitter_us;       // filtered error against deadline, early or late
+        uint32_t jitter_max_us;
+        uint32_t not_sent;     // runs that sent nothing, not air collisions
+    };
+
+    const Stats &get_stats(Job job) const {
+        return jobs[uint8_t(job)].stats;
+    }
+
+    static const char *job_name(Job job);
+
+private:
+    static const uint8_t NUM_JOBS = uint8_t(Job::NUM_JOBS);
+
+    struct JobState {
+        float rate_hz;
+        uint32_t period_us;
+        // fractional part of the period in 1/65536 us, carried in
+        // frac_accum so long term rate is exact
+        uint16_t period_frac;
+        uint32_t frac_accum;
+        uint32_t deadline_us;
+        uint32_t last_run_us;
+        bool enabled;
+        Stats stats;
+    } jobs[NUM_JOBS];
+
+    // indexes of enabled jobs, ordered by deadline
+    uint8_t queue[NUM_JOBS];
+    uint8_t queue_len;
+
+    // task waiting in sleep_until_next()
+    std::atomic<void *> sleep_task;
+
+    void queue_remove(uint8_t idx);
+    void queue_insert(uint8_t idx);
+    void advance_deadline(JobState &j);
+    void update_stats(JobState &j, uint32_t now_us);
+};
+
+extern TxScheduler tx_sched;
@@ -0,0 +1,57 @@
+/*
+  double buffered seqlock snapshot of the UAS data
+
+  each buffer has a sequence number which is odd while the writer is
+  filling it. The reader copies the latest buffer and checks the
+  sequence number is unchanged and even, retrying otherwise
+ */
+#include <Arduino.h>
+#include "snapshot.h"
+
+SnapshotBuffer uas_snapshot;
+
+void SnapshotBuffer::publish(const ODID_UAS_Data &uas, const ODIDCache &cache, bool transmit,
+                             const Transport::Emergency &emergency, TxProfile::State profile,
+                             uint32_t location_ms)
+{
+    const uint8_t idx = latest.load(std::memory_order_relaxed) ^ 1;
+    auto &b = buf[idx];
+
+    seq[idx].fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    b.uas = uas;
+    b.cache = cache;
+    b.transmit = transmit;
+    b.emergency = emergency;
+    b.profile = profile;
+    b.location_ms = location_ms;
+
+    std::atomic_thread_fence(std::memory_order_release);
+    seq[idx].fetch_add(1, std::memory_order_relaxed);
+
+    latest.store(idx, std::memory_order_release);
+    count.fetch_add(1, std::memory_order_release);
+}
+
+bool SnapshotBuffer::fetch(UASSnapshot &snap)
+{
+    const uint32_t c = count.load(std::memory_order_acquire);
+    if (c == fetched_count) {
+        return false;
+    }
+    while (true) {
+        const uint8_t idx = latest.load(std::memory_order_acquire);
+        const uint32_t s1 = seq[idx].load(std::memory_order_acquire);
+        if ((s1 & 1) == 0) {
+            snap = buf[idx];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq[idx].load(std::memory_order_relaxed) == s1) {
+                break;
+            }
+        }
+        retries++;
+    }
+    fetched_count = c;
+    return true;
+}
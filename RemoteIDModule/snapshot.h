@@ -0,0 +1,69 @@
+/*
+  snapshot of the UAS data passed from the ingest task (transports,
+  parameters and web interface) to the radio task
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <opendroneid.h>
+#include "odid_cache.h"
+#include "transport.h"
+#include "tx_profile.h"
+
+struct UASSnapshot {
+    ODID_UAS_Data uas;
+    ODIDCache cache;
+    // false until we have something we are allowed to broadcast
+    bool transmit;
+    Transport::Emergency emergency;
+    // broadcast profile for the flight state
+    TxProfile::State profile;
+    // millis() when the transport received the location
+    uint32_t location_ms;
+};
+
+/*
+  double buffered seqlock. The writer always fills the buffer the
+  reader was not last pointed at, so the reader only has to retry if
+  two snapshots are published while it is copying one. Neither side
+  ever blocks
+ */
+class SnapshotBuffer {
+public:
+    /*
+      publish a new snapshot, only called from the ingest task
+     */
+    void publish(const ODID_UAS_Data &uas, const ODIDCache &cache, bool transmit,
+                 const Transport::Emergency &emergency, TxProfile::State profile,
+                 uint32_t location_ms);
+
+    /*
+      copy the latest snapshot into snap if it is newer than the
+      snapshot the caller last fetched. Returns true if snap was
+      updated. Only called from the radio task
+     */
+    bool fetch(UASSnapshot &snap);
+
+    // number of snapshots published
+    uint32_t get_count(void) const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    // number of times the reader had to retry a copy
+    uint32_t get_retries(void) const {
+        return retries;
+    }
+
+private:
+    UASSnapshot buf[2];
+    std::atomic<uint32_t> seq[2];
+    std::atomic<uint8_t> latest;
+    std::atomic<uint32_t> count;
+
+    // reader state
+    uint32_t fetched_count;
+    uint32_t retries;
+};
+
+extern SnapshotBuffer uas_snapshot;
@@ -7,9 +7,24 @@
 #include <opendroneid.h>
 #include "status.h"
 #include "util.h"
+#include "scheduler.h"
+#include "power.h"
+#include "transport.h"
+#include "boot.h"
+#include "emergency.h"
+#include "tx_profile.h"
+#include "extrapolate.h"
+#include "timesync.h"
+#include "latency.h"
+#include "legacy_sched.h"
+#include "BLE_TX.h"
+#include "auth_pager.h"
+#include "pack_shaper.h"
+#include "WiFi_TX.h"
+#include "odid_cache.h"
 
 extern ODID_UAS_Data UAS_data;
-extern String status_reason;
+extern uint32_t status_reason;
 
 typedef struct {
     String name;
@@ -218,6 +233,136 @@ static String AltString(float alt)
     return String(alt,2);
 }
 
+/*
+  achieved period and jitter of a transmit job
+ */
+static String sched_string(TxScheduler::Job job)
+{
+    const auto &s = tx_sched.get_stats(job);
+    if (s.count == 0) {
+        return "OFF";
+    }
+    return String(s.period_us*0.001, 1) + " ms (jitter " + String(s.jitter_us*0.001, 2) +
+        " ms, max " + String(s.jitter_max_us*0.001, 1) + " ms, not sent " + String(s.not_sent) + ")";
+}
+
+/*
+  location latency percentiles for a job
+ */
+static String latency_string(TxScheduler::Job job)
+{
+    TxLatency::Stats s;
+    tx_latency.get_stats(job, s);
+    if (s.count == 0) {
+        return "-";
+    }
+    return "p50 " + String(s.p50_ms) + " ms, p95 " + String(s.p95_ms) + " ms, max " + String(s.max_ms) + " ms";
+}
+
+/*
+  achieved rate of a BT4 legacy frame
+ */
+static String legacy_rate_string(ODIDCache::Msg msg)
+{
+    return String(legacy_sched.get_stats().rate_hz[uint8_t(msg)], 2) + " Hz";
+}
+
+/*
+  BLE advertising data updates issued to the stack and skipped
+ */
+static String ble_update_string(TxScheduler::Job job)
+{
+    const auto &s = BLE_TX::get_update_stats(job);
+    return String(s.issued) + " issued, " + String(s.skipped) + " skipped";
+}
+
+/*
+  HCI advertising data command latency and failures for each BLE
+  instance in use
+ */
+static String ble_hci_string(void)
+{
+    String ret = "";
+    for (uint8_t i=0; i<BLE_TX::num_instances(); i++) {
+        BLE_TX::HCIStats s;
+        BLE_TX::get_hci_stats(i, s);
+        if (s.issued == 0) {
+            continue;
+        }
+        ret += String(i) + ": " + String(s.latency_us*0.001, 1) + " ms (max " + String(s.latency_max_us*0.001, 1) + " ms) " +
+            String(s.failed) + " failed " + String(s.coalesced) + " coalesced ";
+    }
+    return ret.length() > 0 ? ret : "-";
+}
+
+/*
+  percentage of time a power lock was held
+ */
+static String duty_string(PowerManager::Lock lock)
+{
+    return String(power.get_duty_cycle(lock)*100, 2) + " %";
+}
+
+/*
+  time from boot to the end of a startup phase
+ */
+static String boot_string(BootTimeline::Phase phase)
+{
+    const uint32_t t_us = boot.get_us(phase);
+    if (t_us == 0) {
+        return "-";
+    }
+    return String(t_us*0.001, 1) + " ms";
+}
+
+/*
+  latency from the transport to the first frame on each radio for the
+  last emergency
+ */
+static String emergency_latency_string(void)
+{
+    const auto &s = emergency.get_stats();
+    if (s.count == 0) {
+        return "-";
+    }
+    String ret = "";
+    for (uint8_t i=0; i<uint8_t(TxScheduler::Job::NUM_JOBS); i++) {
+        if (s.latency_us[i] == 0) {
+            continue;
+        }
+        ret += String(TxScheduler::job_name(TxScheduler::Job(i))) + " " + String(s.latency_us[i]*0.001, 1) + " ms ";
+    }
+    return ret + "(max " + String(s.latency_max_us*0.001, 1) + " ms)";
+}
+
+/*
+  time for the last full cycle through the auth pages on each radio
+ */
+static String auth_cycle_string(void)
+{
+    String ret = "";
+    for (uint8_t i=0; i<uint8_t(TxScheduler::Job::NUM_JOBS); i++) {
+        const uint32_t cycle_ms = auth_pager.get_cycle_ms(TxScheduler::Job(i));
+        if (cycle_ms == 0) {
+            continue;
+        }
+        ret += String(TxScheduler::job_name(TxScheduler::Job(i))) + " " + String(cycle_ms*0.001, 1) + " s ";
+    }
+    return ret.length() > 0 ? ret : "-";
+}
+
+/*
+  average number of messages in the packs of a job
+ */
+static String pack_msgs_string(TxScheduler::Job job)
+{
+    const float avg = pack_shaper.get_avg_msgs(job);
+    if (avg <= 0) {
+        return "OFF";
+    }
+    return String(avg, 2) + " msgs";
+}
+
 #define ENUM_MAP(ename, v) enum_string(enum_ ## ename, ARRAY_SIZE(enum_ ## ename), int(v))
 
 String status_json(void)
@@ -230,9 +375,12 @@ String status_json(void)
     snprintf(minsec_str, sizeof(minsec_str), "%02d:%02d", min, sec);
     char githash[20];
     snprintf(githash, sizeof(githash), "(%08x)", GIT_VERSION);
-    String reason = "";
-    if (status_reason != nullptr && status_reason.length() > 0) {
-        reason = "(" + status_reason + ")";
+    static char reason[100];
+    reason[0] = 0;
+    if (status_reason != Transport::ARM_FAIL_NONE) {
+        reason[0] = '(';
+        const uint8_t len = Transport::format_arm_fail(status_reason, &reason[1], sizeof(reason)-2);
+        strcpy(&reason[1+len], ")");
     }
     const json_table_t table[] = {
         { "STATUS:VERSION", String(FW_VERSION_MAJOR) + "." + String(FW_VERSION_MINOR) + " " + githash},
@@ -278,6 +426,58 @@ String status_json(void)
         { "LOCATION:SpeedAccuracy", ENUM_MAP(sacc, UAS_data.Location.SpeedAccuracy) },
         { "LOCATION:TSAccuracy", ENUM_MAP(tsacc, UAS_data.Location.TSAccuracy) },
         { "LOCATION:TimeStamp", String(UAS_data.Location.TimeStamp) },
+        { "SCHED:WIFI_NAN", sched_string(TxScheduler::Job::WIFI_NAN) },
+        { "SCHED:WIFI_BCN", sched_string(TxScheduler::Job::WIFI_BEACON) },
+        { "SCHED:BT5", sched_string(TxScheduler::Job::BT5) },
+        { "SCHED:BT4", sched_string(TxScheduler::Job::BT4) },
+        { "SCHED:BT5_1M", sched_string(TxScheduler::Job::BT5_1M) },
+        { "BT4:Location", legacy_rate_string(ODIDCache::Msg::LOCATION) },
+        { "BT4:BasicID", legacy_rate_string(ODIDCache::Msg::BASIC_ID_1) },
+        { "BT4:BasicID2", legacy_rate_string(ODIDCache::Msg::BASIC_ID_2) },
+        { "BT4:SelfID", legacy_rate_string(ODIDCache::Msg::SELF_ID) },
+        { "BT4:System", legacy_rate_string(ODIDCache::Msg::SYSTEM) },
+        { "BT4:OperatorID", legacy_rate_string(ODIDCache::Msg::OPERATOR_ID) },
+        { "BT4:Name", String(legacy_sched.get_stats().rate_hz[LegacyScheduler::NAME_FRAME], 2) + " Hz" },
+        { "BT4:Refreshes", String(legacy_sched.get_stats().refreshes) },
+        { "BLE:BT4Updates", ble_update_string(TxScheduler::Job::BT4) },
+        { "BLE:BT5Updates", ble_update_string(TxScheduler::Job::BT5) },
+        { "BLE:BT5_1MUpdates", ble_update_string(TxScheduler::Job::BT5_1M) },
+        { "BLE:HCI", ble_hci_string() },
+        { "PACK:WIFI_NAN", pack_msgs_string(TxScheduler::Job::WIFI_NAN) },
+        { "PACK:WIFI_BCN", pack_msgs_string(TxScheduler::Job::WIFI_BEACON) },
+        { "PACK:BT5", pack_msgs_string(TxScheduler::Job::BT5) },
+        { "PACK:BT5_1M", pack_msgs_string(TxScheduler::Job::BT5_1M) },
+        { "WIFI:FrameBytes", String(WiFi_TX::get_build_stats().frame_Bps, 0) + " B/s" },
+        { "WIFI:BuiltBytes", String(WiFi_TX::get_build_stats().written_Bps, 0) + " B/s" },
+        { "WIFI:NanSync", String(WiFi_TX::get_nan_stats().sync_sent) + " sync, " + String(WiFi_TX::get_nan_stats().action_sent) + " action" },
+        { "WIFI:VendorIE", String(WiFi_TX::get_ie_stats().calls) + " calls, " + String(WiFi_TX::get_ie_stats().skipped) + " skipped" },
+        { "AUTH:Pages", String(odid_cache.auth_pages()) + " (" + String(auth_pager.get_pages_sent()) + " sent)" },
+        { "AUTH:Cycle", auth_cycle_string() },
+        { "POWER:Mode", PowerManager::mode_name(power.get_mode()) },
+        { "POWER:CPUMHz", String(getCpuFrequencyMhz()) },
+        { "POWER:IngestDuty", duty_string(PowerManager::Lock::INGEST) },
+        { "POWER:RadioDuty", duty_string(PowerManager::Lock::RADIO) },
+        { "EMERGENCY:Count", String(emergency.get_stats().count) },
+        { "EMERGENCY:Latency", emergency_latency_string() },
+        { "PROFILE:State", TxProfile::state_name(tx_profile.get_state()) },
+        { "PROFILE:Changes", String(tx_profile.get_changes()) },
+        { "TIMESYNC:Source", TimeSync::source_name(timesync.get_source()) },
+        { "TIMESYNC:RTT", String(timesync.get_rtt_us()*0.001, 1) + " ms" },
+        { "LATENCY:WIFI_NAN", latency_string(TxScheduler::Job::WIFI_NAN) },
+        { "LATENCY:WIFI_BCN", latency_string(TxScheduler::Job::WIFI_BEACON) },
+        { "LATENCY:BT5", latency_string(TxScheduler::Job::BT5) },
+        { "LATENCY:BT4", latency_string(TxScheduler::Job::BT4) },
+        { "LATENCY:BT5_1M", latency_string(TxScheduler::Job::BT5_1M) },
+        { "EXTRAP:Count", String(extrapolator.get_stats().count) },
+        { "EXTRAP:Age", String(extrapolator.get_stats().last_ms) + " ms (max " + String(extrapolator.get_stats().max_ms) + " ms)" },
+        { "BOOT:PARAMS", boot_string(BootTimeline::Phase::PARAMS) },
+        { "BOOT:SERIAL", boot_string(BootTimeline::Phase::SERIAL_PORTS) },
+        { "BOOT:TRANSPORTS", boot_string(BootTimeline::Phase::TRANSPORTS) },
+        { "BOOT:SETUP", boot_string(BootTimeline::Phase::SETUP) },
+        { "BOOT:RADIO_INIT", boot_string(BootTimeline::Phase::RADIO_INIT) },
+        { "BOOT:FIRST_TX", boot_string(BootTimeline::Phase::FIRST_TX) },
+        { "BOOT:WEBSERVER", boot_string(BootTimeline::Phase::WEBSERVER) },
+        { "BOOT:FW_CHECK", boot_string(BootTimeline::Phase::FW_CHECK) },
     };
     return json_format(table, ARRAY_SIZE(table));
 }
@@ -0,0 +1,61 @@
+/*
+  time synchronisation with the flight controller
+
+  MAVLink gives UTC in SYSTEM_TIME, corrected by half the TIMESYNC
+  round trip time. DroneCAN gives the time master clock in
+  GlobalTimeSync, which we can only use when the master publishes UTC
+ */
+#include <Arduino.h>
+#include "timesync.h"
+
+TimeSync timesync;
+
+// 2020-01-01 in microseconds since the Unix epoch
+#define TIMESYNC_UTC_MIN_US 1577836800000000ULL
+
+// the synchronisation is lost if not updated for this long
+#define TIMESYNC_TIMEOUT_MS 30000
+
+const char *TimeSync::source_name(Source s)
+{
+    switch (s) {
+    case Source::NONE:
+        return "NONE";
+    case Source::MAVLINK:
+        return "MAVLINK";
+    case Source::DRONECAN:
+        return "DRONECAN";
+    default:
+        break;
+    }
+    return "UNKNOWN";
+}
+
+void TimeSync::set_utc(uint64_t utc_us, int64_t local_us, Source _source)
+{
+    if (utc_us < TIMESYNC_UTC_MIN_US) {
+        return;
+    }
+    if (_source == Source::MAVLINK) {
+        // SYSTEM_TIME was sent about half a round trip ago
+        utc_us += rtt_us.load(std::memory_order_relaxed) / 2;
+    }
+    offset_us.store(int64_t(utc_us) - local_us, std::memory_order_relaxed);
+    source.store(_source, std::memory_order_release);
+    last_ms.store(millis(), std::memory_order_relaxed);
+}
+
+void TimeSync::set_rtt(uint32_t _rtt_us)
+{
+    rtt_us.store(_rtt_us, std::memory_order_relaxed);
+}
+
+bool TimeSync::get_utc_us(int64_t local_us, uint64_t &utc_us) const
+{
+    if (source.load(std::memory_order_acquire) == Source::NONE ||
+        millis() - last_ms.load(std::memory_order_relaxed) > TIMESYNC_TIMEOUT_MS) {
+        return false;
+    }
+    utc_us = uint64_t(local_us + offset_us.load(std::memory_order_relaxed));
+    return true;
+}
@@ -0,0 +1,56 @@
+/*
+  time synchronisation with the flight controller
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+class TimeSync {
+public:
+    enum class Source : uint8_t {
+        NONE=0,
+        MAVLINK,
+        DRONECAN,
+    };
+
+    /*
+      the flight controller UTC time in microseconds was utc_us at
+      esp_timer time local_us. Times before 2020 are ignored, as the
+      flight controller has no UTC yet
+     */
+    void set_utc(uint64_t utc_us, int64_t local_us, Source source);
+
+    // MAVLink TIMESYNC round trip time
+    void set_rtt(uint32_t rtt_us);
+
+    uint32_t get_rtt_us(void) const {
+        return rtt_us.load(std::memory_order_relaxed);
+    }
+
+    /*
+      UTC time in microseconds at esp_timer time local_us, false if we
+      are not synchronised. May be called from any task
+     */
+    bool get_utc_us(int64_t local_us, uint64_t &utc_us) const;
+
+    Source get_source(void) const {
+        return source.load(std::memory_order_relaxed);
+    }
+
+    // millis() of the last update, 0 if never synchronised
+    uint32_t get_last_ms(void) const {
+        return last_ms.load(std::memory_order_relaxed);
+    }
+
+    static const char *source_name(Source source);
+
+private:
+    // UTC minus esp_timer time
+    std::atomic<int64_t> offset_us;
+    std::atomic<uint32_t> rtt_us;
+    std::atomic<Source> source;
+    std::atomic<uint32_t> last_ms;
+};
+
+extern TimeSync timesync;
@@ -6,8 +6,9 @@
 #include "parameters.h"
 #include "util.h"
 #include "monocypher.h"
+#include <esp_timer.h>
 
-const char *Transport::parse_fail = "uninitialised";
+uint32_t Transport::parse_fail = Transport::ARM_FAIL_UNINITIALISED;
 
 uint32_t Transport::last_location_ms;
 uint32_t Transport::last_basic_id_ms;
@@ -16,10 +17,12 @@ uint32_t Transport::last_operator_id_ms;
 uint32_t Transport::last_system_ms;
 uint32_t Transport::last_system_timestamp;
 float Transport::last_location_timestamp;
+Transport::Generation Transport::generation;
+Transport::Emergency Transport::emergency;
 
 mavlink_open_drone_id_location_t Transport::location;
 mavlink_open_drone_id_basic_id_t Transport::basic_id;
-mavlink_open_drone_id_authentication_t Transport::authentication;
+mavlink_open_drone_id_authentication_t Transport::authentication[ODID_AUTH_MAX_PAGES];
 mavlink_open_drone_id_self_id_t Transport::self_id;
 mavlink_open_drone_id_system_t Transport::system;
 mavlink_open_drone_id_operator_id_t Transport::operator_id;
@@ -31,66 +34,116 @@ Transport::Transport()
 /*
   check we are OK to arm
  */
-uint8_t Transport::arm_status_check(const char *&reason)
+uint8_t Transport::arm_status_check(uint32_t &reasons)
 {
     const uint32_t max_age_location_ms = 3000;
     const uint32_t max_age_other_ms = 22000;
     const uint32_t now_ms = millis();
 
-    uint8_t status = MAV_ODID_ARM_STATUS_PRE_ARM_FAIL_GENERIC;
-
     //return status OK if we have enabled the force arm option
     if (g.options & OPTIONS_FORCE_ARM_OK) {
-        status = MAV_ODID_ARM_STATUS_GOOD_TO_ARM;
-        return status;
+        return MAV_ODID_ARM_STATUS_GOOD_TO_ARM;
     }
 
-    String ret = "";
-
     if (last_location_ms == 0 || now_ms - last_location_ms > max_age_location_ms) {
-        ret += "LOC ";
+        reasons |= ARM_FAIL_LOC;
     }
     if (!g.have_basic_id_info()) {
         // if there is no basic ID data stored in the parameters give warning. If basic ID data are streamed to RID device,
         // it will store them in the parameters
-        ret += "ID ";
+        reasons |= ARM_FAIL_ID;
     }
 
     if (last_self_id_ms == 0  || now_ms - last_self_id_ms > max_age_other_ms) {
-        ret += "SELF_ID ";
+        reasons |= ARM_FAIL_SELF_ID;
     }
 
     if (last_operator_id_ms == 0 || now_ms - last_operator_id_ms > max_age_other_ms) {
-        ret += "OP_ID ";
+        reasons |= ARM_FAIL_OP_ID;
     }
 
     if (last_system_ms == 0 || now_ms - last_system_ms > max_age_location_ms) {
         // we use location age limit for system as the operator location needs to come in as fast
         // as the vehicle location for FAA standard
-        ret += "SYS ";
+        reasons |= ARM_FAIL_SYS;
     }
 
     if (location.latitude == 0 && location.longitude == 0) {
-        ret += "LOC ";
+        reasons |= ARM_FAIL_LOC;
     }
 
     if (system.operator_latitude == 0 && system.operator_longitude == 0) {
-        ret += "OP_LOC ";
+        reasons |= ARM_FAIL_OP_LOC;
     }
 
-    if (ret.length() == 0 && reason == nullptr) {
-        status = MAV_ODID_ARM_STATUS_GOOD_TO_ARM;
-    } else {
-        static char return_string[200];
-        memset(return_string, 0, sizeof(return_string));
-        if (reason != nullptr) {
-            strlcpy(return_string, reason, sizeof(return_string));
+    if (reasons == ARM_FAIL_NONE) {
+        return MAV_ODID_ARM_STATUS_GOOD_TO_ARM;
+    }
+    return MAV_ODID_ARM_STATUS_PRE_ARM_FAIL_GENERIC;
+}
+
+static const struct {
+    uint32_t mask;
+    const char *name;
+} arm_fail_names[] = {
+    { Transport::ARM_FAIL_BAD_LOC, "LOC" },
+    { Transport::ARM_FAIL_BAD_SYS, "SYS" },
+    { Transport::ARM_FAIL_BAD_ID_1, "ID_1" },
+    { Transport::ARM_FAIL_BAD_ID_2, "ID_2" },
+    { Transport::ARM_FAIL_BAD_SELF_ID, "SELF_ID" },
+    { Transport::ARM_FAIL_BAD_OP_ID, "OP_ID" },
+    { Transport::ARM_FAIL_LOC, "LOC" },
+    { Transport::ARM_FAIL_ID, "ID" },
+    { Transport::ARM_FAIL_SELF_ID, "SELF_ID" },
+    { Transport::ARM_FAIL_OP_ID, "OP_ID" },
+    { Transport::ARM_FAIL_SYS, "SYS" },
+    { Transport::ARM_FAIL_OP_LOC, "OP_LOC" },
+};
+
+/*
+  format reasons as text, for example "bad LOC data SELF_ID OP_LOC".
+  Text that does not fit in buf is truncated
+ */
+uint8_t Transport::format_arm_fail(uint32_t reasons, char *buf, uint8_t buflen)
+{
+    const uint32_t bad_mask = ARM_FAIL_BAD_LOC | ARM_FAIL_BAD_SYS | ARM_FAIL_BAD_ID_1 |
+        ARM_FAIL_BAD_ID_2 | ARM_FAIL_BAD_SELF_ID | ARM_FAIL_BAD_OP_ID;
+
+    buf[0] = 0;
+    if (reasons & ARM_FAIL_UNINITIALISED) {
+        strlcat(buf, "uninitialised ", buflen);
+    }
+    if (reasons & bad_mask) {
+        strlcat(buf, "bad ", buflen);
+    }
+    for (const auto &n : arm_fail_names) {
+        if (n.mask == ARM_FAIL_LOC && (reasons & bad_mask)) {
+            // end of the bad data list
+            strlcat(buf, "data ", buflen);
+        }
+        if (reasons & n.mask) {
+            strlcat(buf, n.name, buflen);
+            strlcat(buf, " ", buflen);
         }
-        strlcat(return_string, ret.c_str(), sizeof(return_string));
-        reason = return_string;
     }
+    uint8_t len = strnlen(buf, buflen);
+    if (len > 0 && buf[len-1] == ' ') {
+        buf[--len] = 0;
+    }
+    return len;
+}
 
-    return status;
+void Transport::update_emergency(void)
+{
+    const bool loc_emergency = location.status == MAV_ODID_STATUS_EMERGENCY;
+    const bool self_id_emergency = self_id.description_type == MAV_ODID_DESC_TYPE_EMERGENCY;
+    const bool active = loc_emergency || self_id_emergency;
+    if (active && !emergency.active) {
+        emergency.count++;
+        emergency.start_us = esp_timer_get_time();
+        emergency.from_self_id = !loc_emergency;
+    }
+    emergency.active = active;
 }
 
 /*
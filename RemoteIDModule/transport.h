@@ -4,6 +4,7 @@
 #pragma once
 
 #include "mavlink_msgs.h"
+#include <opendroneid.h>
 
 /*
   abstraction for opendroneid transports
@@ -13,7 +14,73 @@ public:
     Transport();
     virtual void init(void) = 0;
     virtual void update(void) = 0;
-    uint8_t arm_status_check(const char *&reason);
+
+    /*
+      reasons we are not ready to arm, as a bitmask. Text is only
+      produced with format_arm_fail() when a reason is sent or shown
+     */
+    enum ArmFail : uint32_t {
+        ARM_FAIL_NONE = 0,
+        ARM_FAIL_UNINITIALISED = (1U<<0),
+        // message data that failed to encode
+        ARM_FAIL_BAD_LOC = (1U<<1),
+        ARM_FAIL_BAD_SYS = (1U<<2),
+        ARM_FAIL_BAD_ID_1 = (1U<<3),
+        ARM_FAIL_BAD_ID_2 = (1U<<4),
+        ARM_FAIL_BAD_SELF_ID = (1U<<5),
+        ARM_FAIL_BAD_OP_ID = (1U<<6),
+        // missing or stale data
+        ARM_FAIL_LOC = (1U<<7),
+        ARM_FAIL_ID = (1U<<8),
+        ARM_FAIL_SELF_ID = (1U<<9),
+        ARM_FAIL_OP_ID = (1U<<10),
+        ARM_FAIL_SYS = (1U<<11),
+        ARM_FAIL_OP_LOC = (1U<<12),
+    };
+
+    /*
+      add the arm check failures to reasons, returning the MAVLink
+      arm status
+     */
+    uint8_t arm_status_check(uint32_t &reasons);
+
+    /*
+      format a reasons bitmask as text into buf, returning the length
+      of the text
+     */
+    static uint8_t format_arm_fail(uint32_t reasons, char *buf, uint8_t buflen);
+
+    /*
+      generation counters for each message type, incremented each
+      time a message of that type is received on any transport
+     */
+    struct Generation {
+        uint32_t location;
+        uint32_t basic_id;
+        uint32_t authentication;
+        uint32_t self_id;
+        uint32_t system;
+        uint32_t operator_id;
+    };
+
+    const Generation &get_generation(void) const {
+        return generation;
+    }
+
+    /*
+      emergency declared by the flight controller, with a Location
+      status of EMERGENCY or an emergency SelfID
+     */
+    struct Emergency {
+        bool active;
+        uint32_t count;     // number of transitions into emergency
+        int64_t start_us;   // esp_timer time of the last transition
+        bool from_self_id;  // last transition was from SelfID
+    };
+
+    const Emergency &get_emergency(void) const {
+        return emergency;
+    }
 
     const mavlink_open_drone_id_location_t &get_location(void) const {
         return location;
@@ -23,8 +90,9 @@ public:
         return basic_id;
     }
 
-    const mavlink_open_drone_id_authentication_t &get_authentication(void) const {
-        return authentication;
+    // the last authentication message received for each page
+    const mavlink_open_drone_id_authentication_t &get_authentication(uint8_t page) const {
+        return authentication[page];
     }
 
     const mavlink_open_drone_id_self_id_t &get_self_id(void) const {
@@ -47,18 +115,19 @@ public:
         return last_system_ms;
     }
     
-    void set_parse_fail(const char *msg) {
-        parse_fail = msg;
+    void set_parse_fail(uint32_t reasons) {
+        parse_fail = reasons;
     }
 
-    const char *get_parse_fail(void) {
+    // ArmFail bitmask, ARM_FAIL_NONE when OK to arm
+    uint32_t get_parse_fail(void) const {
         return parse_fail;
     }
     
 protected:
     // common variables between transports. The last message of each
     // type, no matter what transport it was on, wins
-    static const char *parse_fail;
+    static uint32_t parse_fail;
 
     static uint32_t last_location_ms;
     static uint32_t last_basic_id_ms;
@@ -68,15 +137,24 @@ protected:
     static uint32_t last_system_timestamp;
     static float last_location_timestamp;
 
+    static Generation generation;
+    static Emergency emergency;
+
     static mavlink_open_drone_id_location_t location;
     static mavlink_open_drone_id_basic_id_t basic_id;
-    static mavlink_open_drone_id_authentication_t authentication;
+    static mavlink_open_drone_id_authentication_t authentication[ODID_AUTH_MAX_PAGES];
     static mavlink_open_drone_id_self_id_t self_id;
     static mavlink_open_drone_id_system_t system;
     static mavlink_open_drone_id_operator_id_t operator_id;
 
     void make_session_key(uint8_t key[8]) const;
 
+    /*
+      check for a transition into emergency, called by the transports
+      when a Location or SelfID is received
+     */
+    void update_emergency(void);
+
     /*
       check signature in a command against public keys
     */
@@ -0,0 +1,76 @@
+/*
+  broadcast profiles
+
+  the rate and power parameters are the airborne profile, which is
+  also used in an emergency. On the ground the rates are scaled by
+  GND_RATE_SCALE and the power reduced by GND_POWER_DROP dB, cutting
+  airtime and power while the aircraft sits on the ground
+ */
+#include <Arduino.h>
+#include "tx_profile.h"
+#include "parameters.h"
+#include <opendroneid.h>
+
+TxProfile tx_profile;
+
+const char *TxProfile::state_name(State state)
+{
+    switch (state) {
+    case State::AIRBORNE:
+        return "AIRBORNE";
+    case State::GROUND:
+        return "GROUND";
+    case State::EMERGENCY:
+        return "EMERGENCY";
+    default:
+        break;
+    }
+    return "UNKNOWN";
+}
+
+TxProfile::State TxProfile::select(uint8_t status, bool link_ok)
+{
+    if (status == ODID_STATUS_EMERGENCY) {
+        return State::EMERGENCY;
+    }
+    if (link_ok && status == ODID_STATUS_GROUND) {
+        return State::GROUND;
+    }
+    return State::AIRBORNE;
+}
+
+TxProfile::State TxProfile::update(uint8_t status, bool link_ok)
+{
+    const State new_state = select(status, link_ok);
+    if (new_state != state) {
+        state = new_state;
+        changes++;
+    }
+    return state;
+}
+
+void TxProfile::get_settings(State state, Settings &s)
+{
+    s.wifi_nan_rate = g.wifi_nan_rate;
+    s.wifi_beacon_rate = g.wifi_beacon_rate;
+    s.wifi_power = g.wifi_power;
+    s.bt4_rate = g.bt4_rate;
+    s.bt4_power = g.bt4_power;
+    s.bt5_rate = g.bt5_rate;
+    s.bt5_power = g.bt5_power;
+    s.bt5_1m_rate = g.bt5_1m_rate;
+    s.bt5_1m_power = g.bt5_1m_power;
+
+    if (state != State::GROUND) {
+        return;
+    }
+    s.wifi_nan_rate *= g.gnd_rate_scale;
+    s.wifi_beacon_rate *= g.gnd_rate_scale;
+    s.bt4_rate *= g.gnd_rate_scale;
+    s.bt5_rate *= g.gnd_rate_scale;
+    s.bt5_1m_rate *= g.gnd_rate_scale;
+    s.wifi_power -= g.gnd_power_drop;
+    s.bt4_power -= g.gnd_power_drop;
+    s.bt5_power -= g.gnd_power_drop;
+    s.bt5_1m_power -= g.gnd_power_drop;
+}
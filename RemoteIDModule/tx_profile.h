@@ -0,0 +1,63 @@
+/*
+  broadcast profiles, transmit rates and power selected at runtime
+  from the flight state
+ */
+#pragma once
+
+#include <stdint.h>
+
+class TxProfile {
+public:
+    // the zero value is the airborne profile, the fail-safe default
+    enum class State : uint8_t {
+        AIRBORNE=0,
+        GROUND,
+        EMERGENCY,
+        NUM_STATES
+    };
+
+    struct Settings {
+        float wifi_nan_rate;
+        float wifi_beacon_rate;
+        float wifi_power;
+        float bt4_rate;
+        float bt4_power;
+        float bt5_rate;
+        float bt5_power;
+        float bt5_1m_rate;
+        float bt5_1m_power;
+    };
+
+    /*
+      select the profile from the ODID Location status. If we have no
+      recent location from the flight controller the link is unhealthy
+      and we use the airborne profile, as we can't tell if we are
+      flying
+     */
+    static State select(uint8_t status, bool link_ok);
+
+    /*
+      select the profile in the ingest task, counting changes of
+      profile for the status page
+     */
+    State update(uint8_t status, bool link_ok);
+
+    State get_state(void) const {
+        return state;
+    }
+
+    uint32_t get_changes(void) const {
+        return changes;
+    }
+
+    // the rates and powers for a profile, from the parameters
+    static void get_settings(State state, Settings &s);
+
+    static const char *state_name(State state);
+
+private:
+    State state;
+    uint32_t changes;
+};
+
+extern TxProfile tx_profile;
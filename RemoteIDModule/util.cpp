@@ -91,7 +91,7 @@ char *base64_encode(const uint8_t *d, int len)
             idx = (d[byte_offset] >> (2-bit_offset)) & 0x3FU;
         } else {
             idx = (d[byte_offset] << (bit_offset-2)) & 0x3FU;
-            if (byte_offset+1 < len) {
+            if (byte_offset+1 < uint32_t(len)) {
                 idx |= (d[byte_offset+1] >> (8-(bit_offset-2)));
             }
         }
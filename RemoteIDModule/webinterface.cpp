@@ -10,6 +10,7 @@
 #include "romfs.h"
 #include "check_firmware.h"
 #include "status.h"
+#include "profile.h"
 
 static WebServer server(80);
 
@@ -72,15 +73,23 @@ class ROMFS_Handler : public RequestHandler
 class AJAX_Handler : public RequestHandler
 {
     bool canHandle(HTTPMethod method, String uri) {
-        return uri == "/ajax/status.json";
+        return uri == "/ajax/status.json" || uri == "/ajax/perf.json";
     }
 
     bool handle(WebServer& server, HTTPMethod requestMethod, String requestUri) {
-        if (requestUri != "/ajax/status.json") {
-            return false;
+        if (requestUri == "/ajax/status.json") {
+            server.send(200, "application/json", status_json());
+            return true;
         }
-        server.send(200, "application/json", status_json());
-        return true;
+        if (requestUri == "/ajax/perf.json") {
+            // ?reset clears the profiler after reporting
+            server.send(200, "application/json", profile_json());
+            if (server.hasArg("reset")) {
+                profiler.reset();
+            }
+            return true;
+        }
+        return false;
     }
 
 } AJAX_Handler;